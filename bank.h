@@ -0,0 +1,21 @@
+#if !defined(BANK_H_)
+#define BANK_H_
+
+// Switching of the 16KB PRG bank at $8000-$BFFF, see bank.s.
+// The bank last mapped is kept in bank_prg, so mapping it again is next to free.
+// Whatever maps another bank maps back the one it found, which is BANK_CODE outside
+// of them: the encoder can be called from the fixed bank without mapping it first.
+
+#define BANK_CODE 4 // holds the encoder, as in bank.s
+
+// bank mapped at $8000, only written by bank_set
+extern unsigned char bank_prg;
+#pragma zpsym ("bank_prg")
+
+// map bank at $8000, unless it already is
+void __fastcall__ bank_set(unsigned char bank);
+// far call: map bank, call fn, then map back the bank mapped before and return what
+// fn returned. bank_call itself is in the fixed bank, fn may be in any of them
+unsigned int __fastcall__ bank_call(unsigned char bank, unsigned int (*fn)(void));
+
+#endif // BANK_H_
@@ -0,0 +1,179 @@
+;switching of the 16KB PRG bank at $8000-$BFFF, the last 16KB stay fixed at $C000
+;
+;the bank registers cannot be read back, so the bank last mapped is kept in
+;_bank_prg, and mapping it again costs a compare instead of the writes to the mapper.
+;whatever maps another bank maps back the one it found, which is BANK_CODE outside
+;of them. neither the NMI nor the IRQ switch banks, so no switch is ever cut in two
+;
+;built for MMC1 by default, and for MMC3 when MAPPER_MMC3 is defined, which maps
+;each 16KB bank as the two 8KB banks it is made of, see mapper_mmc3.cfg. MMC3 only
+;fixes the last 8KB at power on, so its reset vector goes to bank_reset up there first
+
+
+	.export bank_init,_bank_set,_bank_call
+	.exportzp _bank_prg
+.ifdef MAPPER_MMC3
+	.export bank_reset
+	.import start
+.endif
+	.import popa
+	.importzp ptr1,tmp1,tmp2
+
+BANK_CODE		=4	;holds the encoder, as in bank.h
+
+.ifdef MAPPER_MMC3
+MMC3_SELECT		=$8000
+MMC3_DATA		=$8001
+MMC3_MIRRORING		=$a000
+MMC3_PRG_RAM		=$a001
+MMC3_IRQ_DISABLE	=$e000
+MMC3_PRG_8000		=6	;registers of the 8KB banks at $8000 and $A000
+MMC3_PRG_A000		=7
+.else
+MMC1_CONTROL		=$8000
+MMC1_PRG		=$e000
+.endif
+
+
+
+.segment "ZEROPAGE"
+
+_bank_prg:		.res 1
+
+
+
+.segment "CODE"
+
+;write the bank in A, which is already in _bank_prg, to the mapper. keeps X and Y
+
+.ifdef MAPPER_MMC3
+
+.segment "RESET"
+
+;the reset vector, in the last 8KB. any write to the select register sets PRG mode 0,
+;which fixes the 8KB at $C000 as well, where crt0.s and bank_init are
+
+bank_reset:
+
+	sei
+	lda #MMC3_PRG_8000
+	sta MMC3_SELECT
+	jmp start
+
+.segment "CODE"
+
+;two single writes per 8KB bank, the select register also keeps PRG mode 0, which
+;fixes the second to last 8KB bank at $C000
+
+.macro BANK_WRITE
+	lda #MMC3_PRG_8000
+	sta MMC3_SELECT
+	lda <_bank_prg
+	asl a
+	sta MMC3_DATA
+	lda #MMC3_PRG_A000
+	sta MMC3_SELECT
+	lda <_bank_prg
+	asl a
+	ora #1
+	sta MMC3_DATA
+.endmacro
+
+
+
+;called by crt0.s before anything else runs from the switchable bank
+;turns the IRQ off, sets vertical mirroring, enables WRAM, lays the 8KB of CHR RAM
+;out in order, then maps BANK_CODE whatever _bank_prg says
+
+bank_init:
+
+	sta MMC3_IRQ_DISABLE
+	lda #0
+	sta MMC3_MIRRORING
+	lda #$80
+	sta MMC3_PRG_RAM
+	ldx #5
+@chr:
+	stx MMC3_SELECT
+	lda chr_banks,x
+	sta MMC3_DATA
+	dex
+	bpl @chr
+	lda #BANK_CODE
+	sta <_bank_prg
+	BANK_WRITE
+	rts
+
+chr_banks:		.byte 0,2,4,5,6,7	;1KB units of the 2KB and 1KB CHR registers
+
+.else
+
+;one bit at a time from the lowest, five serial writes. banks are below 16, so bit 4
+;is written clear, which keeps WRAM enabled
+
+.macro BANK_WRITE
+	sta MMC1_PRG
+	lsr a
+	sta MMC1_PRG
+	lsr a
+	sta MMC1_PRG
+	lsr a
+	sta MMC1_PRG
+	lsr a
+	sta MMC1_PRG
+.endmacro
+
+
+
+;called by crt0.s before anything else runs from the switchable bank
+;resets the shift register, which also fixes the last bank at $C000, then maps
+;BANK_CODE whatever _bank_prg says
+
+bank_init:
+
+	lda #$80
+	sta MMC1_CONTROL
+	lda #BANK_CODE
+	sta <_bank_prg
+	BANK_WRITE
+	rts
+
+.endif
+
+
+
+;void __fastcall__ bank_set(unsigned char bank);
+;keeps X and Y
+
+_bank_set:
+
+	cmp <_bank_prg
+	beq @done
+	sta <_bank_prg
+	BANK_WRITE
+@done:
+	rts
+
+
+
+;unsigned int __fastcall__ bank_call(unsigned char bank,unsigned int (*fn)(void));
+
+_bank_call:
+
+	sta <ptr1
+	stx <ptr1+1
+	lda <_bank_prg
+	pha
+	jsr popa
+	jsr _bank_set
+	jsr @call
+	sta <tmp1
+	stx <tmp2
+	pla
+	jsr _bank_set
+	lda <tmp1
+	ldx <tmp2
+	rts
+
+@call:
+	jmp (ptr1)
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+
+import csv
+import re
+import subprocess
+import sys
+
+# Which kernels are run, at which versions and how many times
+kernels = [
+  ('appendBitsToQrcode', 32),
+  ('reedSolomonComputeRemainder', 4),
+  ('drawCodewords', 2),
+  ('applyMask', 4),
+  ('getPenaltyScore', 1),
+  ('qrcodegen_encodeBinary', 1),
+]
+versions = [1, 10, 27]
+
+# A kernel that takes this much longer than in the baseline is a regression
+regression_threshold = 0.01
+
+### DO NOT MODIFY BELOW ###
+
+usage = '''Usage: %s [sim65] [kernels program] [CSV output] [baseline CSV]
+Counts the cycles each kernel of the encoder takes under sim65, and writes them as CSV
+to the output and to stdout. Given the CSV of an earlier run as a baseline, also prints
+how much every count changed, and fails if any went up by more than %.0f%%.'''
+
+fields = ['kernel', 'version', 'unit', 'units', 'cycles_per_call', 'cycles_per_unit']
+
+
+def run_cycles(sim65, program, kernel, version, calls, run):
+  args = [sim65, '-c', program, kernel, str(version), str(calls), '1' if run else '0']
+  result = subprocess.run(args, capture_output=True, text=True)
+  if result.returncode != 0:
+    sys.exit('%s failed with %d' % (' '.join(args), result.returncode))
+  cycles = re.search(r'(\d+) cycles', result.stdout + result.stderr)
+  if cycles is None:
+    sys.exit('sim65 printed no cycle count')
+  units, unit = result.stdout.split()[:2]
+  return int(cycles.group(1)), int(units), unit
+
+
+def measure(sim65, program, kernel, version, calls):
+  skipped, _, _ = run_cycles(sim65, program, kernel, version, calls, False)
+  ran, units, unit = run_cycles(sim65, program, kernel, version, calls, True)
+  per_call = (ran - skipped) / calls
+  return {
+    'kernel': kernel,
+    'version': version,
+    'unit': unit,
+    'units': units,
+    'cycles_per_call': round(per_call),
+    'cycles_per_unit': round(per_call / units, 1),
+  }
+
+
+def compare(rows, baseline_path):
+  with open(baseline_path, newline='') as f:
+    baseline = {(row['kernel'], int(row['version'])): int(row['cycles_per_call']) for row in csv.DictReader(f)}
+  regressed = False
+  for row in rows:
+    before = baseline.get((row['kernel'], row['version']))
+    if before is None:
+      continue
+    change = (row['cycles_per_call'] - before) / before
+    regressed |= change > regression_threshold
+    print('%-28s v%-2d %10d -> %10d %+7.2f%%' % (row['kernel'], row['version'], before, row['cycles_per_call'], change * 100), file=sys.stderr)
+  return regressed
+
+
+def main():
+  if len(sys.argv) not in (4, 5):
+    sys.exit(usage % (sys.argv[0], regression_threshold * 100))
+  sim65, program, output_path = sys.argv[1:4]
+
+  rows = [measure(sim65, program, kernel, version, calls) for kernel, calls in kernels for version in versions]
+
+  with open(output_path, 'w', newline='') as f:
+    writer = csv.DictWriter(f, fieldnames=fields, lineterminator='\n')
+    writer.writeheader()
+    writer.writerows(rows)
+  writer = csv.DictWriter(sys.stdout, fieldnames=fields, lineterminator='\n')
+  writer.writeheader()
+  writer.writerows(rows)
+
+  if len(sys.argv) == 5 and compare(rows, sys.argv[4]):
+    sys.exit('Regressed by more than %.0f%%' % (regression_threshold * 100))
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,179 @@
+// Runs one kernel of the encoder under sim65 on a fixed input, for bench.py to count
+// its cycles: sim65 only reports the cycles of a whole run, so each kernel is run calls
+// times after its inputs are set up, and once more with the kernel itself skipped.
+// The difference between the two runs is what the calls of the kernel took.
+//
+// Usage: kernels <kernel> <version> <calls> <0 to skip the kernel, 1 to run it>
+// Prints how many units (bits, bytes or modules) one call goes through, and the unit.
+
+// The private functions are what is measured, so they are built in with the driver
+#include "qrcodegen.c"
+#include <stdio.h>
+
+#define BENCH_ECL qrcodegen_Ecc_MEDIUM
+#define BENCH_MASK qrcodegen_Mask_0
+
+struct kernel
+{
+  const char *name;
+  const char *unit;
+  void (*prepare)(void);
+  void (*run)(void);
+  uint16_t (*units)(void);
+};
+
+extern void rsmt_stub_init (void);
+
+static uint8_t bench_size (void);
+
+static void prepare_nothing (void)
+{
+}
+
+static void prepare_append_bits (void)
+{
+  bitLen = 0;
+  qrcode[1] = 0;
+}
+
+static void run_append_bits (void)
+{
+  appendBitsToQrcode(0xEC, 8);
+}
+
+static uint16_t units_append_bits (void)
+{
+  return 8;
+}
+
+// One block of the data codewords as laid out by qrcodegen_encodeBinary(), with the
+// generator of its ECL and version
+static void prepare_remainder (void)
+{
+  uint8_t numBlocks = NUM_ERROR_CORRECTION_BLOCKS[ecl][version];
+  d.addEccAndInterleave.blockEccLen = ECC_CODEWORDS_PER_BLOCK[ecl][version];
+  d.addEccAndInterleave.datLen = getNumRawDataModules() / 8 / numBlocks - d.addEccAndInterleave.blockEccLen;
+  reedSolomonComputeDivisor(d.addEccAndInterleave.blockEccLen, d.addEccAndInterleave.rsdiv);
+  d.addEccAndInterleave.dat = text;
+  d.addEccAndInterleave.ecc = tempBuffer;
+}
+
+static void run_remainder (void)
+{
+  reedSolomonComputeRemainder();
+}
+
+static uint16_t units_remainder (void)
+{
+  return d.addEccAndInterleave.datLen;
+}
+
+// Leaves only the function modules dark, as drawCodewords() expects. tempBuffer still
+// holds the function modules, which are drawn as the codewords.
+static void prepare_draw (void)
+{
+  initializeFunctionModules(qrcode);
+  d.drawCodewords.datLen = getNumRawDataModules() / 8;
+}
+
+static void run_draw (void)
+{
+  drawCodewords();
+}
+
+static void run_apply_mask (void)
+{
+  applyMask(BENCH_MASK);
+}
+
+static void run_penalty (void)
+{
+  getPenaltyScore();
+}
+
+static void prepare_encode (void)
+{
+  ecl = BENCH_ECL;
+  mask = qrcodegen_Mask_AUTO;
+}
+
+static void run_encode (void)
+{
+  qrcodegen_encodeBinary();
+}
+
+static uint16_t units_modules (void)
+{
+  return (uint16_t)bench_size() * bench_size();
+}
+
+static uint16_t units_text (void)
+{
+  return dataLen;
+}
+
+static const struct kernel kernels[] = {
+  { "appendBitsToQrcode", "bit", prepare_append_bits, run_append_bits, units_append_bits },
+  { "reedSolomonComputeRemainder", "byte", prepare_remainder, run_remainder, units_remainder },
+  { "drawCodewords", "module", prepare_draw, run_draw, units_modules },
+  { "applyMask", "module", prepare_nothing, run_apply_mask, units_modules },
+  { "getPenaltyScore", "module", prepare_nothing, run_penalty, units_modules },
+  { "qrcodegen_encodeBinary", "byte", prepare_encode, run_encode, units_text },
+};
+
+static uint8_t bench_size (void)
+{
+  return version * 4 + 17;
+}
+
+int main (int argc, char **argv)
+{
+  const struct kernel *kernel = NULL;
+  uint8_t i, requested;
+  unsigned calls, call;
+  uint16_t n;
+  bool run;
+
+  if (argc != 5)
+  {
+    return 1;
+  }
+  for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i)
+  {
+    if (strcmp(argv[1], kernels[i].name) == 0)
+    {
+      kernel = &kernels[i];
+    }
+  }
+  requested = (uint8_t)atoi(argv[2]);
+  calls = (unsigned)atoi(argv[3]);
+  run = argv[4][0] == '1';
+  if (kernel == NULL || requested < MIN_VERSION || requested > MAX_VERSION)
+  {
+    return 1;
+  }
+
+  // The largest text that fits the version, encoded with a fixed mask so that qrcode
+  // and tempBuffer are left as a real encoding would leave them
+  rsmt_stub_init();
+  ecl = BENCH_ECL;
+  mask = BENCH_MASK;
+  boostEcl = false;
+  dataLen = qr_capacity[ecl][requested];
+  for (n = 0; n < dataLen; ++n)
+  {
+    text[n] = 'A' + n % 26;
+  }
+  qrcodegen_encodeBinary();
+
+  for (call = 0; call < calls; ++call)
+  {
+    kernel->prepare();
+    if (run)
+    {
+      kernel->run();
+    }
+  }
+  printf("%u %s\n", kernel->units(), kernel->unit);
+  return 0;
+}
@@ -0,0 +1,135 @@
+  .export _reedSolomonMultiply, _reedSolomonMultiplyAdd
+  .export _rsmt_stub_init
+  .importzp ptr1, ptr2, ptr3, tmp1, tmp3, _bank_prg
+  .import popa, popax, _bank_set
+
+; Stand-in for rsmt.s under sim65, which can neither hold its 64KB of tables nor switch
+; banks. The banks are switched through bank.s like on the NES, whose writes to $E000
+; go to plain RAM here, but the product comes from log and exp tables, which takes
+; about 15 cycles more than the lookup of rsmt.s.
+
+  .segment "BSS"
+
+log_table: .res 256
+exp_table: .res 512 ; twice over, so the sum of two logs needs no modulo
+
+  .segment "CODE"
+
+; void rsmt_stub_init(void)
+_rsmt_stub_init:
+  ; Powers of the generator 2 in GF(2^8/0x11D)
+  lda #1
+  ldx #0
+@next:
+  sta exp_table,x
+  sta exp_table+255,x
+  tay
+  txa
+  sta log_table,y
+  tya
+  asl
+  bcc @reduced
+  eor #$1d
+@reduced:
+  inx
+  cpx #255
+  bne @next
+  rts
+
+; uint8_t __fastcall__ reedSolomonMultiply(uint8_t x, uint8_t y)
+_reedSolomonMultiply:
+  ; A is the y-position, select its bank as rsmt.s does
+  tax
+  lda _bank_prg
+  sta tmp1
+  txa
+  rol
+  rol
+  rol
+  and #%00000011
+  jsr _bank_set
+
+  ; Keep y in place of the high byte of the table index
+  stx ptr1+1
+
+  ; Pop x-position from stack
+  jsr popa
+  tax
+  beq @zero
+  ldy ptr1+1
+  beq @zero
+
+  ; x * y = exp(log x + log y)
+  lda log_table,x
+  clc
+  adc log_table,y
+  tax
+  bcs @high
+  lda exp_table,x
+  jmp @restore
+@high:
+  lda exp_table+256,x
+  jmp @restore
+@zero:
+  lda #0
+
+@restore:
+  tax
+  lda tmp1
+  jsr _bank_set
+  txa
+  ldx #0
+  rts
+
+; void __fastcall__ reedSolomonMultiplyAdd(uint8_t result[], const uint8_t x[], uint8_t len, uint8_t y)
+_reedSolomonMultiplyAdd:
+  ; A is the y-position, select its bank once as rsmt.s does
+  tax
+  lda _bank_prg
+  pha
+  txa
+  rol
+  rol
+  rol
+  and #%00000011
+  jsr _bank_set
+  stx tmp3 ; y
+
+  jsr popa
+  sta tmp1 ; len
+  jsr popax
+  sta ptr2 ; x
+  stx ptr2+1
+  jsr popax
+  sta ptr3 ; result
+  stx ptr3+1
+
+  ldy #0
+@next:
+  lda (ptr2),y
+  beq @skip
+  tax
+  lda tmp3
+  beq @skip
+
+  ; x * y = exp(log x + log y)
+  lda log_table,x
+  ldx tmp3
+  clc
+  adc log_table,x
+  tax
+  bcs @high
+  lda exp_table,x
+  jmp @add
+@high:
+  lda exp_table+256,x
+@add:
+  eor (ptr3),y
+  sta (ptr3),y
+@skip:
+  iny
+  cpy tmp1
+  bne @next
+
+  pla
+  jmp _bank_set
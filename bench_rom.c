@@ -0,0 +1,142 @@
+#include "neslib.h"
+#include "bank.h"
+#include "build/chr.h"
+#include "build/capacity.h"
+#include "qr_tiles.h"
+#include "screen.h"
+#include "vramq.h"
+#include <string.h>
+
+// The main of qrdemo_bench.nes, which has no editor: it encodes and uploads a corpus
+// of texts unattended, and keeps how many frames each one took in battery-backed WRAM
+// for benchsav.py to turn into CSV. For every ECL, with mask 0 and then with the mask
+// picked automatically, the texts fill each version from 1 to QR_CAPACITY_MAX_VERSION
+// to capacity, which covers every length the encoder sees a new version at.
+
+#define BENCH_CASES (4 * 2 * QR_CAPACITY_MAX_VERSION)
+#define SETTINGS_AUTO 0x08 // settings bit of a result whose mask was picked automatically
+
+// Modules in color 1 on white, and the font in color 3
+static const char palette[] = {
+  0x30, 0x0f, 0x0f, 0x30,
+};
+static const uint8_t result_magic[4] = "QRBN";
+static const uint8_t done_text[] = "BENCHMARK DONE";
+
+#pragma bss-name (push, "RESULTS")
+
+// As read by benchsav.py, at the start of the XRAM area of mapper.cfg, where the RESULTS
+// segment goes ahead of WRAM
+static struct
+{
+  uint8_t magic[4]; // result_magic once the sweep has started
+  uint16_t total; // BENCH_CASES
+  uint16_t count; // results written so far, total once the sweep is over
+  struct
+  {
+    uint16_t len;
+    uint8_t version;
+    uint8_t settings; // ECL in bits 4-5, SETTINGS_AUTO, mask used in bits 0-2
+    uint16_t encode_frames;
+    uint8_t upload_frames;
+  } results[BENCH_CASES];
+} table;
+
+#pragma bss-name (pop)
+
+static struct
+{
+  uint8_t auto_mask;
+  uint8_t version;
+  uint8_t y;
+  uint16_t start;
+  uint16_t i;
+} d;
+
+void fastcall _clear (void);
+void fastcall _run (void);
+
+void main (void)
+{
+  chr_rodata_ascii_vram_write();
+  qr_tiles_init();
+
+  // Printable characters, the same at every run
+  for (d.i = 0; d.i < QR_CAPACITY_MAX_TEXT; ++d.i)
+  {
+    text[d.i] = ' ' + d.i % 95;
+  }
+  boostEcl = false;
+
+  // Results of an earlier run are dropped as soon as a new one starts
+  memcpy(table.magic, result_magic, sizeof(result_magic));
+  table.total = BENCH_CASES;
+  table.count = 0;
+
+  pal_bg(palette);
+  bank_bg(1);
+  ppu_on_all();
+
+  for (ecl = qrcodegen_Ecc_LOW; ecl <= qrcodegen_Ecc_HIGH; ++ecl)
+  {
+    for (d.auto_mask = 0; d.auto_mask < 2; ++d.auto_mask)
+    {
+      for (d.version = 1; d.version <= QR_CAPACITY_MAX_VERSION; ++d.version)
+      {
+        _run();
+      }
+    }
+  }
+
+  // The font shows white on black, like in the editor
+  _clear();
+  vramq_wait();
+  bank_bg(0);
+  pal_col(0, 0x0f);
+  vramq_put(NTADR_A(9, 14), done_text, sizeof(done_text) - 1);
+  while (1)
+  {
+    ppu_wait_nmi();
+  }
+}
+
+void fastcall _clear (void)
+{
+  // The split of the previous code goes away with it, before sprite 0 does
+  bank_bg_split(0xff);
+  scroll_split(0, 0xffff);
+  oam_clear();
+  for (d.y = 0; d.y < 30; ++d.y)
+  {
+    vramq_fill(NTADR_A(0, d.y), 0, 32);
+  }
+  vramq_fill(NAMETABLE_A + 0x3c0, 0, 64);
+}
+
+// Encodes and uploads the text that fills d.version at ecl, the same way the QR screen does
+void fastcall _run (void)
+{
+  dataLen = qr_capacity[ecl][d.version];
+  mask = d.auto_mask ? qrcodegen_Mask_AUTO : qrcodegen_Mask_0;
+
+  // The previous code and its split go first, so no NMI of the encode waits for sprite 0
+  _clear();
+  vramq_wait();
+  d.start = nesclock16();
+  bank_call(BANK_CODE, (unsigned int (*)(void))qrcodegen_encodeBinary);
+  table.results[table.count].encode_frames = nesclock16() - d.start;
+
+  d.start = nesclock16();
+  qr_tiles_begin(false);
+  for (d.y = 0; d.y < qr_tiles_side; ++d.y)
+  {
+    qr_tiles_row(d.y);
+  }
+  vramq_wait();
+  table.results[table.count].upload_frames = nesclock16() - d.start;
+
+  table.results[table.count].len = dataLen;
+  table.results[table.count].version = (qrcodegen_getSize() - 17) >> 2;
+  table.results[table.count].settings = ecl << 4 | (d.auto_mask ? SETTINGS_AUTO : 0) | mask;
+  ++table.count;
+}
@@ -0,0 +1,61 @@
+# Start of XRAM in mapper.cfg, where qrdemo_bench.nes keeps its results
+results_address = 0x6800
+# Frames per second of the NES, NTSC
+frame_rate = 60.0988
+
+### DO NOT MODIFY BELOW ###
+
+import csv
+import sys
+
+if len(sys.argv) != 3:
+  print('Usage:', sys.argv[0], '[sav input] [CSV output]')
+  print('Writes the results qrdemo_bench.nes left in battery-backed WRAM as CSV, - for stdout.')
+  sys.exit(1)
+
+WRAM_ADDRESS = 0x6000
+MAGIC = b'QRBN'
+HEADER_SIZE = 8
+RESULT_SIZE = 7
+SETTINGS_AUTO = 0x08
+FIELDS = ['ecl', 'mask', 'chosen_mask', 'length', 'version', 'encode_frames', 'upload_frames', 'bytes_per_second']
+
+with open(sys.argv[1], 'rb') as sav_in:
+  sav = sav_in.read()
+
+# As laid out by bench_rom.c
+offset = results_address - WRAM_ADDRESS
+if sav[offset:offset + 4] != MAGIC:
+  print('No benchmark results in', sys.argv[1])
+  sys.exit(1)
+total = int.from_bytes(sav[offset + 4:offset + 6], 'little')
+count = int.from_bytes(sav[offset + 6:offset + 8], 'little')
+if count > total or offset + HEADER_SIZE + total * RESULT_SIZE > len(sav):
+  print('Bad benchmark results in', sys.argv[1])
+  sys.exit(1)
+if count < total:
+  print('The benchmark stopped after', count, 'of', total, 'texts', file=sys.stderr)
+
+rows = []
+for i in range(count):
+  result = sav[offset + HEADER_SIZE + i * RESULT_SIZE:offset + HEADER_SIZE + (i + 1) * RESULT_SIZE]
+  length = int.from_bytes(result[0:2], 'little')
+  settings = result[3]
+  encode_frames = int.from_bytes(result[4:6], 'little')
+  upload_frames = result[6]
+  rows.append({
+    'ecl': 'LMQH'[settings >> 4 & 3],
+    'mask': 'A' if settings & SETTINGS_AUTO else str(settings & 7),
+    'chosen_mask': settings & 7,
+    'length': length,
+    'version': result[2],
+    'encode_frames': encode_frames,
+    'upload_frames': upload_frames,
+    'bytes_per_second': round(length * frame_rate / max(encode_frames + upload_frames, 1), 2),
+  })
+
+csv_out = sys.stdout if sys.argv[2] == '-' else open(sys.argv[2], 'w', newline='')
+writer = csv.DictWriter(csv_out, fieldnames=FIELDS, lineterminator='\n')
+writer.writeheader()
+writer.writerows(rows)
+csv_out.close()
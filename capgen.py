@@ -0,0 +1,77 @@
+# Highest QR Code version to support, qrcodegen_BUFFER_WIDTH and WRAM size limit it to 27
+max_version = 27
+
+### DO NOT MODIFY BELOW ###
+
+import sys
+
+if len(sys.argv) != 3:
+  print('Usage:', sys.argv[0], '[header output] [asm output]')
+  print('An asm output ending in .c is written as C instead, for host builds.')
+  sys.exit(1)
+
+# Same tables as qrcodegen.c, by ECC level (L, M, Q, H) and version
+ECC_CODEWORDS_PER_BLOCK = [
+  [-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30],
+  [-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28],
+  [-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30],
+  [-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30],
+]
+NUM_ERROR_CORRECTION_BLOCKS = [
+  [-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25],
+  [-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49],
+  [-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68],
+  [-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81],
+]
+
+def raw_data_modules(ver):
+  result = (16 * ver + 128) * ver + 64
+  if ver >= 2:
+    num_align = ver // 7 + 2
+    result -= (25 * num_align - 10) * num_align - 55
+    if ver >= 7:
+      result -= 36
+  return result
+
+def byte_capacity(ecl, ver):
+  data_bits = (raw_data_modules(ver) // 8 - ECC_CODEWORDS_PER_BLOCK[ecl][ver] * NUM_ERROR_CORRECTION_BLOCKS[ecl][ver]) * 8
+  char_count_bits = 8 if ver < 10 else 16
+  return min((data_bits - 4 - char_count_bits) // 8, (1 << char_count_bits) - 1)
+
+# Index 0 is for padding, so that the table is indexed by version
+capacity = [[0] + [byte_capacity(ecl, ver) for ver in range(1, max_version + 1)] for ecl in range(4)]
+
+with open(sys.argv[1], 'w') as header_out:
+  header_out.write("""
+#if !defined(CAPACITY_H_)
+#define CAPACITY_H_
+
+#include <stdint.h>
+
+#define QR_CAPACITY_MAX_VERSION {max_version}
+#define QR_CAPACITY_MAX_TEXT {max_text}
+
+// Most bytes of text a QR Code holds in byte mode, by ECC level and version
+extern const uint16_t qr_capacity[4][QR_CAPACITY_MAX_VERSION + 1];
+
+#endif // CAPACITY_H_
+""".format(max_version=max_version, max_text=capacity[0][max_version]))
+
+with open(sys.argv[2], 'w') as asm_out:
+  if sys.argv[2].endswith('.c'):
+    asm_out.write("""
+#include "capacity.h"
+
+const uint16_t qr_capacity[4][QR_CAPACITY_MAX_VERSION + 1] = {
+""")
+    for row in capacity:
+      asm_out.write("  {{ {} }},\n".format(', '.join(str(c) for c in row)))
+    asm_out.write("};\n")
+  else:
+    asm_out.write("""
+.segment "RODATA"
+  .export _qr_capacity
+_qr_capacity:
+""")
+    for row in capacity:
+      asm_out.write("  .word {}\n".format(','.join(str(c) for c in row)))
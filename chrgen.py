@@ -1,6 +1,6 @@
 # Format: (programmatic name, bank name, CHR-RAM address, start tile, tile count)
 chr_sections = [
-  ('ascii', 'data', '0x0000', 0x000, 0x80),
+  ('ascii', 'rodata', '0x0000', 0x000, 0x80),
 ]
 
 ### DO NOT MODIFY BELOW ###
@@ -10,8 +10,12 @@ FT_SFX_STREAMS			= 4		;number of sound effects played at once, 1..4
 
 
 
-	.export _exit,__STARTUP__:absolute=1
+	.export _exit,start,__STARTUP__:absolute=1
 	.import initlib,push0,popa,popax,_main,zerobss,copydata
+	.import bank_init
+.ifdef MAPPER_MMC3
+	.import bank_reset
+.endif
 
 	; Linker generated symbols
 	.import __RAM_START__   ,__RAM_SIZE__
@@ -19,7 +23,7 @@ FT_SFX_STREAMS			= 4		;number of sound effects played at once, 1..4
 	.import __STARTUP_LOAD__,__STARTUP_RUN__,__STARTUP_SIZE__
 	.import	__CODE_LOAD__   ,__CODE_RUN__   ,__CODE_SIZE__
 	.import	__RODATA_LOAD__ ,__RODATA_RUN__ ,__RODATA_SIZE__
-	.import NES_MAPPER,NES_PRG_BANKS,NES_CHR_BANKS,NES_MIRRORING,NES_PRG_RAM
+	.import NES_MAPPER,NES_PRG_BANKS,NES_CHR_BANKS,NES_MIRRORING,NES_PRG_RAM,NES_BATTERY
 
 	.include "zeropage.inc"
 
@@ -56,6 +60,7 @@ PAL_BUF		=$01c0
 NTSC_MODE: 		.res 1
 FRAME_CNT1: 		.res 1
 FRAME_CNT2: 		.res 1
+FRAME_CNT1_HIGH:	.res 1		;carries of FRAME_CNT1, for nesclock16
 VRAM_UPDATE: 		.res 1
 NAME_UPD_ADR: 		.res 2
 NAME_UPD_ENABLE: 	.res 1
@@ -72,6 +77,10 @@ PAD_STATET: 		.res 2
 PPU_CTRL_VAR:		.res 1
 PPU_CTRL_VAR1:		.res 1
 PPU_MASK_VAR: 		.res 1
+BG_SPLIT:		.res 1		;$80|bg bank bit to switch to at the sprite 0 hit, 0 for none
+SCROLL_SPLIT:		.res 4		;$80|nametable<<2, Y, X and address low byte to set at the sprite 0 hit, 0 for none
+SPLIT_WAIT:		.res 1		;blocks left of the wait for the sprite 0 hit
+NMI_BUSY:		.res 1		;set while the NMI handler runs
 RAND_SEED: 		.res 2
 FT_TEMP: 		.res 3
 
@@ -99,7 +108,7 @@ RLE_BYTE		=TEMP+3
     .byte $4e,$45,$53,$1a
 	.byte <NES_PRG_BANKS
 	.byte <NES_CHR_BANKS
-	.byte <NES_MIRRORING|(<NES_MAPPER<<4)
+	.byte <NES_MIRRORING|<NES_BATTERY|(<NES_MAPPER<<4)
 	.byte <NES_MAPPER&$f0
 	.byte <NES_PRG_RAM
 	.res 7,0
@@ -175,6 +184,8 @@ clearRAM:
 	jsr _pal_clear
 	jsr _oam_clear
 
+	jsr bank_init		;maps BANK_CODE, which also enables WRAM
+
     jsr	zerobss
 	jsr	copydata
 
@@ -223,6 +234,9 @@ detectNTSC:
 	jsr FamiToneSfxInit
 .endif
 
+	lda #VRAMQ_BUDGET_DEFAULT
+	sta <VRAMQ_BUDGET
+
 	lda #$fd
 	sta <RAND_SEED
 	sta <RAND_SEED+1
@@ -237,6 +251,8 @@ detectNTSC:
 	; .include "display.sinc"
 
 	.include "neslib.s"
+	.include "vramq.s"
+	.include "keyboard.s"
 
 .segment "RODATA"
 
@@ -257,5 +273,9 @@ sounds_data:
 .segment "VECTORS"
 
 	.word nmi	;$fffa vblank nmi
+.ifdef MAPPER_MMC3
+	.word bank_reset	;$fffc reset, in the 8KB MMC3 fixes at power on
+.else
 	.word start	;$fffc reset
+.endif
 	.word irq	;$fffe irq / brk
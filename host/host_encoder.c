@@ -0,0 +1,52 @@
+#include "host_encoder.h"
+#include "build/capacity.h"
+#include <string.h>
+
+void host_payload (uint8_t dest[], size_t len, uint32_t seed)
+{
+  size_t i;
+  for (i = 0; i < len; ++i)
+  {
+    seed = seed * 1103515245u + 12345u;
+    dest[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+// Longer data is refused by the encoder before it looks at text
+bool host_encode (const uint8_t data[], size_t len, enum qrcodegen_Ecc ecl_setting, enum qrcodegen_Mask mask_setting, bool boost)
+{
+  if (len <= QR_CAPACITY_MAX_TEXT)
+  {
+    memcpy(text, data, len);
+  }
+  dataLen = len;
+  ecl = ecl_setting;
+  mask = mask_setting;
+  boostEcl = boost;
+  return qrcodegen_encodeBinary();
+}
+
+bool host_reencode (enum qrcodegen_Ecc ecl_setting, enum qrcodegen_Mask mask_setting, bool boost)
+{
+  ecl = ecl_setting;
+  mask = mask_setting;
+  boostEcl = boost;
+  return qrcodegen_reencode();
+}
+
+// FNV-1a
+uint32_t host_hash (void)
+{
+  uint32_t hash = 2166136261u;
+  int size = qrcodegen_getSize();
+  int x, y;
+  hash = (hash ^ (uint32_t)size) * 16777619u;
+  for (y = 0; y < size; ++y)
+  {
+    for (x = 0; x < size; ++x)
+    {
+      hash = (hash ^ (uint32_t)qrcodegen_getModule(x, y)) * 16777619u;
+    }
+  }
+  return hash;
+}
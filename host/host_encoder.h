@@ -0,0 +1,19 @@
+#if !defined(HOST_ENCODER_H_)
+#define HOST_ENCODER_H_
+
+#include "screen.h"
+#include <stdint.h>
+
+// Helpers for the host build of the encoder of the ROM, see CMakeLists.txt
+
+// Fills dest with len bytes made up from seed, the same ones every time
+void host_payload (uint8_t dest[], size_t len, uint32_t seed);
+// Encodes data[0 : len] with the given settings the way screen_qr does, after copying it
+// to text if it fits there. The ECL and mask the code ended up with are left in ecl and mask.
+bool host_encode (const uint8_t data[], size_t len, enum qrcodegen_Ecc ecl_setting, enum qrcodegen_Mask mask_setting, bool boost);
+// Encodes the data of the last host_encode() again with the given settings, the way F1 does
+bool host_reencode (enum qrcodegen_Ecc ecl_setting, enum qrcodegen_Mask mask_setting, bool boost);
+// Hash of the size and every module of the code in qrcode, to compare codes across builds
+uint32_t host_hash (void);
+
+#endif // HOST_ENCODER_H_
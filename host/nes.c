@@ -0,0 +1,668 @@
+#include "nes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FLAG_C 0x01
+#define FLAG_Z 0x02
+#define FLAG_I 0x04
+#define FLAG_D 0x08
+#define FLAG_B 0x10
+#define FLAG_U 0x20
+#define FLAG_V 0x40
+#define FLAG_N 0x80
+
+#define VBLANK_LINE 241
+#define PRERENDER_LINE 261
+#define OAM_DMA_CYCLES 513
+
+// Base cycles of every opcode, page crossings and taken branches add to them
+static const uint8_t cycle_table[256] = {
+  7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,
+  2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+  6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6,
+  2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+  6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6,
+  2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+  6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6,
+  2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+  2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
+  2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,
+  2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
+  2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,
+  2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
+  2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+  2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
+  2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+};
+
+static unsigned extra; // cycles of the current instruction on top of cycle_table
+
+static void _write (struct nes *nes, uint16_t addr, uint8_t value);
+static void _ppu_advance (struct nes *nes, unsigned cycles);
+
+bool nes_load (struct nes *nes, const char *path)
+{
+  uint8_t header[16];
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  memset(nes, 0, sizeof(*nes));
+  if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, "NES\x1a", 4) != 0)
+  {
+    fprintf(stderr, "%s: not an iNES file\n", path);
+    fclose(f);
+    return false;
+  }
+  if ((header[6] >> 4 | (header[7] & 0xf0)) != 1 || header[4] == 0 || header[4] > NES_PRG_BANKS_MAX)
+  {
+    fprintf(stderr, "%s: not an MMC1 cartridge of at most %d PRG banks\n", path, NES_PRG_BANKS_MAX);
+    fclose(f);
+    return false;
+  }
+  if (header[6] & 0x04)
+  {
+    fseek(f, 512, SEEK_CUR); // trainer
+  }
+  nes->prg_banks = header[4];
+  nes->prg = malloc((size_t)nes->prg_banks * NES_PRG_BANK_SIZE);
+  if (nes->prg == NULL || fread(nes->prg, NES_PRG_BANK_SIZE, nes->prg_banks, f) != nes->prg_banks)
+  {
+    fprintf(stderr, "%s: PRG ROM is cut short\n", path);
+    fclose(f);
+    return false;
+  }
+  fclose(f);
+  nes_reset(nes);
+  return true;
+}
+
+void nes_reset (struct nes *nes)
+{
+  nes->shift = 0x10;
+  nes->control = 0x0c; // the last bank fixed at $C000
+  nes->cpu.s = 0xfd;
+  nes->cpu.p = FLAG_I | FLAG_U;
+  nes->cpu.pc = nes_read(nes, 0xfffc) | nes_read(nes, 0xfffd) << 8;
+}
+
+uint8_t nes_bank (const struct nes *nes, uint16_t addr)
+{
+  uint8_t high = addr >= 0xc000;
+  switch ((nes->control >> 2) & 3)
+  {
+  case 0:
+  case 1:
+    return ((nes->prg_bank & 0x0e) | high) % nes->prg_banks;
+  case 2:
+    return high ? nes->prg_bank % nes->prg_banks : 0;
+  default:
+    return high ? nes->prg_banks - 1 : nes->prg_bank % nes->prg_banks;
+  }
+}
+
+/*---- Keyboard ----*/
+
+// Bits 1 to 4 are the keys of the selected row and column, 0 for a held key. Past the
+// last row they read as 1, and as 0 while the keyboard is disabled.
+static uint8_t _keyboard_read (struct nes *nes)
+{
+  uint8_t result = 0, bit;
+  if (!nes->kbd_enabled)
+  {
+    return 0;
+  }
+  if (nes->kbd_row >= NES_KEYBOARD_KEYS / 8)
+  {
+    return 0x1e;
+  }
+  for (bit = 1; bit <= 4; ++bit)
+  {
+    if (!nes->keys[nes->kbd_row * 8 + nes->kbd_column * 4 + 4 - bit])
+    {
+      result |= 1 << bit;
+    }
+  }
+  return result;
+}
+
+// Bit 0 goes back to row 0, bit 1 selects the column, and going from column 1 back to
+// column 0 moves on to the next row. Bit 2 enables the keyboard.
+static void _keyboard_write (struct nes *nes, uint8_t value)
+{
+  uint8_t column = (value >> 1) & 1;
+  if (value & 0x01)
+  {
+    nes->kbd_row = 0;
+  }
+  else if (nes->kbd_column == 1 && column == 0)
+  {
+    ++nes->kbd_row;
+  }
+  nes->kbd_column = column;
+  nes->kbd_enabled = (value & 0x04) != 0;
+}
+
+/*---- PPU ----*/
+
+static uint16_t _vram_index (uint16_t addr)
+{
+  addr &= 0x3fff;
+  if (addr >= 0x3f00)
+  {
+    addr &= 0x3f1f;
+    if ((addr & 0x13) == 0x10)
+    {
+      addr &= ~0x10; // the background color of the sprite palettes
+    }
+  }
+  else if (addr >= 0x3000)
+  {
+    addr -= 0x1000;
+  }
+  return addr;
+}
+
+static uint8_t _ppu_read (struct nes *nes, uint16_t reg)
+{
+  uint8_t result;
+  switch (reg & 7)
+  {
+  case 2:
+    result = nes->ppu_status;
+    nes->ppu_status &= ~0x80;
+    nes->write_toggle = false;
+    return result;
+  case 4:
+    return nes->oam[nes->oam_addr];
+  case 7:
+    if ((nes->vram_addr & 0x3fff) >= 0x3f00)
+    {
+      result = nes->vram[_vram_index(nes->vram_addr)];
+    }
+    else
+    {
+      result = nes->read_buffer;
+    }
+    nes->read_buffer = nes->vram[_vram_index(nes->vram_addr)];
+    nes->vram_addr += nes->ppu_ctrl & 0x04 ? 32 : 1;
+    return result;
+  default:
+    return 0;
+  }
+}
+
+static void _ppu_write (struct nes *nes, uint16_t reg, uint8_t value)
+{
+  switch (reg & 7)
+  {
+  case 0:
+    // Enabling the NMI during vblank triggers it at once
+    if (!(nes->ppu_ctrl & 0x80) && (value & 0x80) && (nes->ppu_status & 0x80))
+    {
+      nes->nmi = true;
+    }
+    nes->ppu_ctrl = value;
+    break;
+  case 1:
+    nes->ppu_mask = value;
+    break;
+  case 3:
+    nes->oam_addr = value;
+    break;
+  case 4:
+    nes->oam[nes->oam_addr++] = value;
+    break;
+  case 5:
+    nes->write_toggle = !nes->write_toggle;
+    break;
+  case 6:
+    if (!nes->write_toggle)
+    {
+      nes->vram_addr = (nes->vram_addr & 0x00ff) | (value & 0x3f) << 8;
+    }
+    else
+    {
+      nes->vram_addr = (nes->vram_addr & 0xff00) | value;
+    }
+    nes->write_toggle = !nes->write_toggle;
+    break;
+  case 7:
+    nes->vram[_vram_index(nes->vram_addr)] = value;
+    nes->vram_addr += nes->ppu_ctrl & 0x04 ? 32 : 1;
+    break;
+  }
+}
+
+// Raises the flags of the lines begun in the last cycles: vblank and the NMI, the sprite
+// 0 hit on the line below the top of sprite 0 while both layers are shown, and the
+// clearing of both on the pre-render line
+static void _ppu_advance (struct nes *nes, unsigned cycles)
+{
+  uint32_t before = nes->dot;
+  uint32_t after = before + cycles * 3;
+  uint32_t line = before / 341 + 1;
+  uint32_t hit_line = (uint32_t)nes->oam[0] + 1;
+
+  for (; line * 341 <= after; ++line)
+  {
+    switch (line % 262)
+    {
+    case VBLANK_LINE:
+      nes->ppu_status |= 0x80;
+      ++nes->frame;
+      if (nes->ppu_ctrl & 0x80)
+      {
+        nes->nmi = true;
+      }
+      break;
+    case PRERENDER_LINE:
+      nes->ppu_status &= ~0xc0;
+      break;
+    case 0:
+      break;
+    default:
+      if (line % 262 == hit_line && hit_line < 240 && (nes->ppu_mask & 0x18) == 0x18)
+      {
+        nes->ppu_status |= 0x40;
+      }
+      break;
+    }
+  }
+  nes->dot = after % NES_FRAME_DOTS;
+}
+
+/*---- Memory ----*/
+
+uint8_t nes_read (struct nes *nes, uint16_t addr)
+{
+  if (addr < 0x2000)
+  {
+    return nes->ram[addr & 0x7ff];
+  }
+  if (addr < 0x4000)
+  {
+    return _ppu_read(nes, addr);
+  }
+  if (addr == 0x4017)
+  {
+    return _keyboard_read(nes);
+  }
+  if (addr < 0x6000)
+  {
+    return 0;
+  }
+  if (addr < 0x8000)
+  {
+    return nes->wram[addr - 0x6000];
+  }
+  return nes->prg[(size_t)nes_bank(nes, addr) * NES_PRG_BANK_SIZE + (addr & (NES_PRG_BANK_SIZE - 1))];
+}
+
+static void _mmc1_write (struct nes *nes, uint16_t addr, uint8_t value)
+{
+  bool full = nes->shift & 1;
+  if (value & 0x80)
+  {
+    nes->shift = 0x10;
+    nes->control |= 0x0c;
+    return;
+  }
+  nes->shift = (nes->shift >> 1) | (value & 1) << 4;
+  if (!full)
+  {
+    return;
+  }
+  switch ((addr >> 13) & 3)
+  {
+  case 0:
+    nes->control = nes->shift;
+    break;
+  case 3:
+    nes->prg_bank = nes->shift & 0x0f;
+    break;
+  default:
+    break; // CHR banks, the cartridge has CHR RAM
+  }
+  nes->shift = 0x10;
+}
+
+static void _write (struct nes *nes, uint16_t addr, uint8_t value)
+{
+  unsigned i;
+  if (addr < 0x2000)
+  {
+    nes->ram[addr & 0x7ff] = value;
+  }
+  else if (addr < 0x4000)
+  {
+    _ppu_write(nes, addr, value);
+  }
+  else if (addr == 0x4014)
+  {
+    for (i = 0; i < 256; ++i)
+    {
+      nes->oam[(uint8_t)(nes->oam_addr + i)] = nes_read(nes, (uint16_t)(value << 8 | i));
+    }
+    // The CPU is halted meanwhile, its instruction takes that much longer
+    extra += OAM_DMA_CYCLES + (nes->cycles & 1);
+  }
+  else if (addr == 0x4016)
+  {
+    _keyboard_write(nes, value);
+  }
+  else if (addr >= 0x6000 && addr < 0x8000)
+  {
+    nes->wram[addr - 0x6000] = value;
+  }
+  else if (addr >= 0x8000)
+  {
+    _mmc1_write(nes, addr, value);
+  }
+}
+
+/*---- CPU ----*/
+
+static uint8_t _fetch (struct nes *nes)
+{
+  return nes_read(nes, nes->cpu.pc++);
+}
+
+static uint16_t _fetch16 (struct nes *nes)
+{
+  uint16_t low = _fetch(nes);
+  return low | _fetch(nes) << 8;
+}
+
+static uint16_t _indexed (uint16_t base, uint8_t index, bool penalty)
+{
+  uint16_t addr = base + index;
+  if (penalty && ((addr ^ base) & 0xff00))
+  {
+    ++extra;
+  }
+  return addr;
+}
+
+static uint16_t _zp16 (struct nes *nes, uint8_t zp)
+{
+  return nes_read(nes, zp) | nes_read(nes, (uint8_t)(zp + 1)) << 8;
+}
+
+static void _push (struct nes *nes, uint8_t value)
+{
+  nes->ram[0x100 | nes->cpu.s--] = value;
+}
+
+static uint8_t _pull (struct nes *nes)
+{
+  return nes->ram[0x100 | ++nes->cpu.s];
+}
+
+static uint8_t _nz (struct nes *nes, uint8_t value)
+{
+  nes->cpu.p = (nes->cpu.p & ~(FLAG_N | FLAG_Z)) | (value & FLAG_N) | (value ? 0 : FLAG_Z);
+  return value;
+}
+
+static void _adc (struct nes *nes, uint8_t value)
+{
+  unsigned sum = nes->cpu.a + value + (nes->cpu.p & FLAG_C);
+  nes->cpu.p &= ~(FLAG_C | FLAG_V);
+  if (sum > 0xff)
+  {
+    nes->cpu.p |= FLAG_C;
+  }
+  if (~(nes->cpu.a ^ value) & (nes->cpu.a ^ sum) & 0x80)
+  {
+    nes->cpu.p |= FLAG_V;
+  }
+  nes->cpu.a = _nz(nes, (uint8_t)sum);
+}
+
+static void _compare (struct nes *nes, uint8_t reg, uint8_t value)
+{
+  nes->cpu.p = (nes->cpu.p & ~FLAG_C) | (reg >= value ? FLAG_C : 0);
+  _nz(nes, (uint8_t)(reg - value));
+}
+
+static uint8_t _shift (struct nes *nes, uint8_t op, uint8_t value)
+{
+  uint8_t carry_in = nes->cpu.p & FLAG_C;
+  uint8_t result;
+  switch (op)
+  {
+  case 0: // ASL
+    nes->cpu.p = (nes->cpu.p & ~FLAG_C) | value >> 7;
+    result = value << 1;
+    break;
+  case 1: // ROL
+    nes->cpu.p = (nes->cpu.p & ~FLAG_C) | value >> 7;
+    result = value << 1 | carry_in;
+    break;
+  case 2: // LSR
+    nes->cpu.p = (nes->cpu.p & ~FLAG_C) | (value & 1);
+    result = value >> 1;
+    break;
+  default: // ROR
+    nes->cpu.p = (nes->cpu.p & ~FLAG_C) | (value & 1);
+    result = value >> 1 | carry_in << 7;
+    break;
+  }
+  return _nz(nes, result);
+}
+
+static void _branch (struct nes *nes, bool taken)
+{
+  int8_t offset = (int8_t)_fetch(nes);
+  uint16_t target;
+  if (taken)
+  {
+    target = nes->cpu.pc + offset;
+    extra += (target ^ nes->cpu.pc) & 0xff00 ? 2 : 1;
+    nes->cpu.pc = target;
+  }
+}
+
+static void _interrupt (struct nes *nes, uint16_t vector, bool brk)
+{
+  _push(nes, nes->cpu.pc >> 8);
+  _push(nes, (uint8_t)nes->cpu.pc);
+  _push(nes, nes->cpu.p | FLAG_U | (brk ? FLAG_B : 0));
+  nes->cpu.p |= FLAG_I;
+  nes->cpu.pc = nes_read(nes, vector) | nes_read(nes, vector + 1) << 8;
+}
+
+// ORA, AND, EOR, ADC, STA, LDA, CMP and SBC, by bits 5 to 7, addressed by bits 2 to 4
+static void _group1 (struct nes *nes, uint8_t opcode)
+{
+  uint8_t op = opcode >> 5;
+  bool read = op != 4;
+  uint16_t addr;
+  switch ((opcode >> 2) & 7)
+  {
+  case 0: addr = _zp16(nes, (uint8_t)(_fetch(nes) + nes->cpu.x)); break;
+  case 1: addr = _fetch(nes); break;
+  case 2: addr = nes->cpu.pc++; break;
+  case 3: addr = _fetch16(nes); break;
+  case 4: addr = _indexed(_zp16(nes, _fetch(nes)), nes->cpu.y, read); break;
+  case 5: addr = (uint8_t)(_fetch(nes) + nes->cpu.x); break;
+  case 6: addr = _indexed(_fetch16(nes), nes->cpu.y, read); break;
+  default: addr = _indexed(_fetch16(nes), nes->cpu.x, read); break;
+  }
+  switch (op)
+  {
+  case 0: nes->cpu.a = _nz(nes, nes->cpu.a | nes_read(nes, addr)); break;
+  case 1: nes->cpu.a = _nz(nes, nes->cpu.a & nes_read(nes, addr)); break;
+  case 2: nes->cpu.a = _nz(nes, nes->cpu.a ^ nes_read(nes, addr)); break;
+  case 3: _adc(nes, nes_read(nes, addr)); break;
+  case 4: _write(nes, addr, nes->cpu.a); break;
+  case 5: nes->cpu.a = _nz(nes, nes_read(nes, addr)); break;
+  case 6: _compare(nes, nes->cpu.a, nes_read(nes, addr)); break;
+  default: _adc(nes, ~nes_read(nes, addr)); break;
+  }
+}
+
+// ASL, ROL, LSR, ROR, STX, LDX, DEC and INC on memory, by bits 5 to 7, addressed by bits
+// 2 to 4, indexed by Y rather than X for STX and LDX
+static void _group2 (struct nes *nes, uint8_t opcode)
+{
+  uint8_t op = opcode >> 5;
+  uint8_t index = op == 4 || op == 5 ? nes->cpu.y : nes->cpu.x;
+  uint16_t addr;
+  switch ((opcode >> 2) & 7)
+  {
+  case 0: addr = nes->cpu.pc++; break;
+  case 1: addr = _fetch(nes); break;
+  case 3: addr = _fetch16(nes); break;
+  case 5: addr = (uint8_t)(_fetch(nes) + index); break;
+  default: addr = _indexed(_fetch16(nes), index, op == 5); break;
+  }
+  switch (op)
+  {
+  case 4: _write(nes, addr, nes->cpu.x); break;
+  case 5: nes->cpu.x = _nz(nes, nes_read(nes, addr)); break;
+  case 6: _write(nes, addr, _nz(nes, nes_read(nes, addr) - 1)); break;
+  case 7: _write(nes, addr, _nz(nes, nes_read(nes, addr) + 1)); break;
+  default: _write(nes, addr, _shift(nes, op, nes_read(nes, addr))); break;
+  }
+}
+
+static bool _is_group2 (uint8_t opcode)
+{
+  uint8_t mode = (opcode >> 2) & 7;
+  return (opcode & 3) == 2 && (mode == 1 || mode == 3 || mode == 5 || mode == 7) && opcode != 0x9e;
+}
+
+unsigned nes_step (struct nes *nes)
+{
+  struct nes_cpu *c = &nes->cpu;
+  uint8_t opcode, value;
+  uint16_t addr;
+  unsigned cycles;
+
+  if (nes->nmi)
+  {
+    nes->nmi = false;
+    nes->opcode = NES_NMI;
+    _interrupt(nes, 0xfffa, false);
+    nes->cycles += 7;
+    _ppu_advance(nes, 7);
+    return 7;
+  }
+
+  opcode = _fetch(nes);
+  nes->opcode = opcode;
+  extra = 0;
+  switch (opcode)
+  {
+  // Flags and registers
+  case 0x18: c->p &= ~FLAG_C; break;
+  case 0x38: c->p |= FLAG_C; break;
+  case 0x58: c->p &= ~FLAG_I; break;
+  case 0x78: c->p |= FLAG_I; break;
+  case 0xb8: c->p &= ~FLAG_V; break;
+  case 0xd8: c->p &= ~FLAG_D; break;
+  case 0xf8: c->p |= FLAG_D; break;
+  case 0xaa: c->x = _nz(nes, c->a); break;
+  case 0x8a: c->a = _nz(nes, c->x); break;
+  case 0xa8: c->y = _nz(nes, c->a); break;
+  case 0x98: c->a = _nz(nes, c->y); break;
+  case 0xba: c->x = _nz(nes, c->s); break;
+  case 0x9a: c->s = c->x; break;
+  case 0xca: c->x = _nz(nes, c->x - 1); break;
+  case 0xe8: c->x = _nz(nes, c->x + 1); break;
+  case 0x88: c->y = _nz(nes, c->y - 1); break;
+  case 0xc8: c->y = _nz(nes, c->y + 1); break;
+  case 0xea: break;
+  case 0x0a: case 0x2a: case 0x4a: case 0x6a:
+    c->a = _shift(nes, opcode >> 5, c->a);
+    break;
+
+  // Stack
+  case 0x48: _push(nes, c->a); break;
+  case 0x68: c->a = _nz(nes, _pull(nes)); break;
+  case 0x08: _push(nes, c->p | FLAG_B | FLAG_U); break;
+  case 0x28: c->p = (_pull(nes) & ~FLAG_B) | FLAG_U; break;
+
+  // Jumps
+  case 0x4c: c->pc = _fetch16(nes); break;
+  case 0x6c:
+    // The pointer does not cross pages
+    addr = _fetch16(nes);
+    c->pc = nes_read(nes, addr) | nes_read(nes, (addr & 0xff00) | (uint8_t)(addr + 1)) << 8;
+    break;
+  case 0x20:
+    addr = _fetch16(nes);
+    --c->pc;
+    _push(nes, c->pc >> 8);
+    _push(nes, (uint8_t)c->pc);
+    c->pc = addr;
+    break;
+  case 0x60:
+    c->pc = _pull(nes);
+    c->pc |= _pull(nes) << 8;
+    ++c->pc;
+    break;
+  case 0x40:
+    c->p = (_pull(nes) & ~FLAG_B) | FLAG_U;
+    c->pc = _pull(nes);
+    c->pc |= _pull(nes) << 8;
+    break;
+  case 0x00:
+    ++c->pc;
+    _interrupt(nes, 0xfffe, true);
+    break;
+
+  // Branches, on N, V, C or Z by bits 6 and 7, being set or clear by bit 5
+  case 0x10: case 0x30: case 0x50: case 0x70: case 0x90: case 0xb0: case 0xd0: case 0xf0:
+    value = (uint8_t[]){ FLAG_N, FLAG_V, FLAG_C, FLAG_Z }[opcode >> 6];
+    _branch(nes, ((c->p & value) != 0) == ((opcode & 0x20) != 0));
+    break;
+
+  // BIT, STY, LDY, CPY and CPX
+  case 0x24: value = nes_read(nes, _fetch(nes)); goto bit;
+  case 0x2c:
+    value = nes_read(nes, _fetch16(nes));
+  bit:
+    c->p = (c->p & ~(FLAG_N | FLAG_V | FLAG_Z)) | (value & (FLAG_N | FLAG_V)) | (value & c->a ? 0 : FLAG_Z);
+    break;
+  case 0x84: _write(nes, _fetch(nes), c->y); break;
+  case 0x8c: _write(nes, _fetch16(nes), c->y); break;
+  case 0x94: _write(nes, (uint8_t)(_fetch(nes) + c->x), c->y); break;
+  case 0xa0: c->y = _nz(nes, _fetch(nes)); break;
+  case 0xa4: c->y = _nz(nes, nes_read(nes, _fetch(nes))); break;
+  case 0xac: c->y = _nz(nes, nes_read(nes, _fetch16(nes))); break;
+  case 0xb4: c->y = _nz(nes, nes_read(nes, (uint8_t)(_fetch(nes) + c->x))); break;
+  case 0xbc: c->y = _nz(nes, nes_read(nes, _indexed(_fetch16(nes), c->x, true))); break;
+  case 0xc0: _compare(nes, c->y, _fetch(nes)); break;
+  case 0xc4: _compare(nes, c->y, nes_read(nes, _fetch(nes))); break;
+  case 0xcc: _compare(nes, c->y, nes_read(nes, _fetch16(nes))); break;
+  case 0xe0: _compare(nes, c->x, _fetch(nes)); break;
+  case 0xe4: _compare(nes, c->x, nes_read(nes, _fetch(nes))); break;
+  case 0xec: _compare(nes, c->x, nes_read(nes, _fetch16(nes))); break;
+
+  default:
+    if ((opcode & 3) == 1 && opcode != 0x89)
+    {
+      _group1(nes, opcode);
+    }
+    else if (_is_group2(opcode) || opcode == 0xa2)
+    {
+      _group2(nes, opcode);
+    }
+    else
+    {
+      --c->pc;
+      return 0;
+    }
+    break;
+  }
+
+  cycles = cycle_table[opcode] + extra;
+  nes->cycles += cycles;
+  _ppu_advance(nes, cycles);
+  return cycles;
+}
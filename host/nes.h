@@ -0,0 +1,67 @@
+#if !defined(NES_H_)
+#define NES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Just enough of an NES to run qrdemo.nes without a screen: the 6502 (official opcodes,
+// with their cycle counts), MMC1 PRG banking, 8KB of WRAM, a PPU that keeps VRAM, OAM,
+// vblank, NMI and the sprite 0 hit of the split on time without drawing anything, and
+// the Family BASIC keyboard. The APU and the rest of the I/O registers are ignored.
+
+#define NES_PRG_BANK_SIZE 0x4000
+#define NES_PRG_BANKS_MAX 32
+#define NES_WRAM_SIZE 0x2000
+#define NES_KEYBOARD_KEYS 72 // matrix indexes, as in keyboard.s
+// NTSC frames are 341 * 262 PPU dots, 3 to a CPU cycle
+#define NES_FRAME_DOTS (341 * 262)
+#define NES_NMI -1
+
+struct nes_cpu
+{
+  uint16_t pc;
+  uint8_t a, x, y, s, p;
+};
+
+struct nes
+{
+  struct nes_cpu cpu;
+  int opcode; // of the last step, NES_NMI if it took the NMI
+  uint64_t cycles;
+  uint64_t frame; // frames begun since reset
+  uint8_t ram[0x800];
+  uint8_t wram[NES_WRAM_SIZE];
+  uint8_t *prg;
+  uint8_t prg_banks;
+  // MMC1
+  uint8_t shift;
+  uint8_t control;
+  uint8_t prg_bank;
+  // PPU
+  uint8_t ppu_ctrl, ppu_mask, ppu_status;
+  uint8_t oam_addr;
+  uint8_t oam[256];
+  uint8_t vram[0x4000];
+  uint16_t vram_addr;
+  uint8_t read_buffer;
+  bool write_toggle;
+  uint32_t dot; // within the frame
+  bool nmi;
+  // Keyboard
+  bool keys[NES_KEYBOARD_KEYS];
+  uint8_t kbd_row, kbd_column;
+  bool kbd_enabled;
+};
+
+// Loads an iNES file of an MMC1 cartridge and resets, false with a message on stderr if it cannot
+bool nes_load (struct nes *nes, const char *path);
+void nes_reset (struct nes *nes);
+// Runs one instruction, or takes the NMI, and returns its cycles. Returns 0 on an
+// opcode that is not an official one, with the CPU left at it.
+unsigned nes_step (struct nes *nes);
+// The 16KB PRG bank seen at $8000 or $C000
+uint8_t nes_bank (const struct nes *nes, uint16_t addr);
+uint8_t nes_read (struct nes *nes, uint16_t addr);
+
+#endif // NES_H_
@@ -0,0 +1,516 @@
+#include "nes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Runs qrdemo.nes on nes.c, typing on its keyboard as a script says, and counts the
+// cycles of every instruction run from a call of the start function until it returns,
+// by the function it belongs to. Functions are the labels of the debug file of ld65,
+// which knows which bank each one is in, and of the label file, for the addresses it
+// has the only label of outside the switchable bank. The flat profile goes to stdout.
+//
+// The script has one command per line, keys being held for KEY_FRAMES frames and then
+// released for as long:
+//   wait <frames>
+//   type <text>        the text after the single space, shifting as needed
+//   press <key>        RETURN, SPACE, BS, LEFT, RIGHT, UP, DOWN, F1 to F4 or F8
+// and # starts a comment.
+
+#define KEY_FRAMES 2
+#define MAX_FRAMES 36000 // ten minutes
+#define START_FUNCTION "_qrcodegen_encodeBinary"
+#define FIXED -1 // bank of the addresses outside $8000-$BFFF
+#define NO_SYMBOL -1
+#define SHIFT_KEY 63 // matrix index of the left SHIFT
+
+struct symbol
+{
+  char *name;
+  uint16_t addr;
+  int bank;
+  uint64_t cycles;
+  uint64_t calls;
+};
+
+struct event
+{
+  uint64_t frame;
+  uint8_t key;
+  bool down;
+};
+
+// Same as kbd_keys in keyboard.s
+static const uint8_t key_codes[NES_KEYBOARD_KEYS] = {
+  ']', '[', 0x0a, 0x04, 0x00, 0x5c, 0x09, 0x00,
+  ';', ':', '@', 0x00, '^', '-', '/', '_',
+  'k', 'l', 'o', 0x00, '0', 'p', ',', '.',
+  'j', 'u', 'i', 0x00, '8', '9', 'n', 'm',
+  'h', 'g', 'y', 0x06, '6', '7', 'v', 'b',
+  'd', 'r', 't', 0x03, '4', '5', 'c', 'f',
+  'a', 's', 'w', 0x02, '3', 'e', 'z', 'x',
+  0x00, 'q', 0x00, 0x01, '2', '1', 0x00, 0x09,
+  0x11, 0x12, 0x13, 0x00, 0x05, 0x08, ' ', 0x14,
+};
+
+static const struct
+{
+  const char *name;
+  uint8_t code;
+} key_names[] = {
+  { "RETURN", 0x0a }, { "SPACE", ' ' }, { "BS", 0x08 },
+  { "LEFT", 0x11 }, { "RIGHT", 0x12 }, { "UP", 0x13 }, { "DOWN", 0x14 },
+  { "F1", 0x01 }, { "F2", 0x02 }, { "F3", 0x03 }, { "F4", 0x06 }, { "F8", 0x04 },
+};
+
+static struct symbol *symbols;
+static size_t symbol_count;
+// Symbol of every address outside the switchable bank, and of every address of each bank
+static int fixed_owner[0x10000];
+static int *bank_owner[NES_PRG_BANKS_MAX];
+
+static struct event *events;
+static size_t event_count;
+
+static struct nes nes;
+
+static void usage (const char *name)
+{
+  fprintf(stderr, "Usage: %s [-d dbg file] [-l label file] [-s sav file] [-f start function] rom script\n", name);
+  fprintf(stderr, "  -f defaults to %s\n", START_FUNCTION);
+  exit(1);
+}
+
+static void add_symbol (const char *name, size_t len, uint16_t addr, int bank)
+{
+  size_t i;
+  for (i = 0; i < symbol_count; ++i)
+  {
+    if (symbols[i].addr == addr && symbols[i].bank == bank)
+    {
+      return; // the first name of an address wins, the debug file is read first
+    }
+  }
+  symbols = realloc(symbols, (symbol_count + 1) * sizeof(*symbols));
+  memset(&symbols[symbol_count], 0, sizeof(*symbols));
+  symbols[symbol_count].name = strndup(name, len);
+  symbols[symbol_count].addr = addr;
+  symbols[symbol_count].bank = bank;
+  ++symbol_count;
+}
+
+// Returns the value of key=value in a line of the debug file, NULL if there is none
+static const char *dbg_field (const char *line, const char *key, size_t *len)
+{
+  size_t key_len = strlen(key);
+  const char *p = line;
+  while ((p = strstr(p, key)) != NULL)
+  {
+    if ((p == line || p[-1] == '\t' || p[-1] == ',') && p[key_len] == '=')
+    {
+      p += key_len + 1;
+      if (*p == '"')
+      {
+        ++p;
+        *len = strcspn(p, "\"");
+      }
+      else
+      {
+        *len = strcspn(p, ",\n");
+      }
+      return p;
+    }
+    p += key_len;
+  }
+  return NULL;
+}
+
+// The labels of ld65's --dbgfile, whose segments tell the bank of each from where they
+// are in the ROM file
+static bool load_dbg (const char *path)
+{
+  char line[1024];
+  long seg_bank[256];
+  const char *name, *val, *seg, *type, *start, *ooffs;
+  size_t name_len, len;
+  unsigned long id, addr;
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  for (id = 0; id < 256; ++id)
+  {
+    seg_bank[id] = FIXED;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (strncmp(line, "seg\t", 4) == 0)
+    {
+      start = dbg_field(line + 4, "start", &len);
+      ooffs = dbg_field(line + 4, "ooffs", &len);
+      id = strtoul(dbg_field(line + 4, "id", &len), NULL, 0);
+      addr = start != NULL ? strtoul(start, NULL, 0) : 0;
+      if (id < 256 && ooffs != NULL && addr >= 0x8000 && addr < 0xc000)
+      {
+        seg_bank[id] = (strtol(ooffs, NULL, 0) - 16) / NES_PRG_BANK_SIZE;
+      }
+    }
+    else if (strncmp(line, "sym\t", 4) == 0)
+    {
+      name = dbg_field(line + 4, "name", &name_len);
+      val = dbg_field(line + 4, "val", &len);
+      seg = dbg_field(line + 4, "seg", &len);
+      type = dbg_field(line + 4, "type", &len);
+      if (name == NULL || val == NULL || seg == NULL || type == NULL || strncmp(type, "lab", 3) != 0)
+      {
+        continue;
+      }
+      id = strtoul(seg, NULL, 0);
+      addr = strtoul(val, NULL, 0);
+      add_symbol(name, name_len, (uint16_t)addr, id < 256 && addr >= 0x8000 && addr < 0xc000 ? (int)seg_bank[id] : FIXED);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// The labels of ld65's -Ln, "al 00C123 .name" lines, which do not tell banks apart
+static bool load_labels (const char *path)
+{
+  char line[512], name[256];
+  unsigned addr;
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (sscanf(line, "al %x .%255s", &addr, name) == 2 && (addr < 0x8000 || addr >= 0xc000) && addr <= 0xffff)
+    {
+      add_symbol(name, strlen(name), (uint16_t)addr, FIXED);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static int compare_symbols (const void *a, const void *b)
+{
+  const struct symbol *sa = a, *sb = b;
+  return sa->bank != sb->bank ? sa->bank - sb->bank : sa->addr - sb->addr;
+}
+
+// Every address belongs to the closest label at or below it, in its bank
+static void map_symbols (void)
+{
+  size_t i;
+  int bank;
+  uint32_t addr;
+  qsort(symbols, symbol_count, sizeof(*symbols), compare_symbols);
+  for (addr = 0; addr < 0x10000; ++addr)
+  {
+    fixed_owner[addr] = NO_SYMBOL;
+  }
+  for (bank = 0; bank < NES_PRG_BANKS_MAX; ++bank)
+  {
+    bank_owner[bank] = malloc(NES_PRG_BANK_SIZE * sizeof(int));
+    for (addr = 0; addr < NES_PRG_BANK_SIZE; ++addr)
+    {
+      bank_owner[bank][addr] = NO_SYMBOL;
+    }
+  }
+  for (i = 0; i < symbol_count; ++i)
+  {
+    if (symbols[i].bank == FIXED)
+    {
+      for (addr = symbols[i].addr; addr < 0x10000 && (i + 1 == symbol_count || symbols[i + 1].bank != FIXED || addr < symbols[i + 1].addr); ++addr)
+      {
+        fixed_owner[addr] = (int)i;
+      }
+    }
+    else if (symbols[i].bank < NES_PRG_BANKS_MAX)
+    {
+      bank = symbols[i].bank;
+      for (addr = symbols[i].addr; addr < 0xc000 && (i + 1 == symbol_count || symbols[i + 1].bank != bank || addr < symbols[i + 1].addr); ++addr)
+      {
+        bank_owner[bank][addr - 0x8000] = (int)i;
+      }
+    }
+  }
+}
+
+static int owner (uint16_t addr)
+{
+  if (addr >= 0x8000 && addr < 0xc000)
+  {
+    return bank_owner[nes_bank(&nes, addr)][addr - 0x8000];
+  }
+  return fixed_owner[addr];
+}
+
+static void add_event (uint64_t frame, uint8_t key, bool down)
+{
+  events = realloc(events, (event_count + 1) * sizeof(*events));
+  events[event_count].frame = frame;
+  events[event_count].key = key;
+  events[event_count].down = down;
+  ++event_count;
+}
+
+// Same as kbd_shift in keyboard.s
+static uint8_t shifted (uint8_t code)
+{
+  if (code >= 0x2c && code < 0x3c)
+  {
+    return code ^ 0x10;
+  }
+  if (code >= 'a' && code <= 'z')
+  {
+    return code ^ 0x20;
+  }
+  return code;
+}
+
+// Presses the key of code at frame, with SHIFT if that is how it is typed, and returns
+// the frame the next key can be pressed at
+static uint64_t press (uint64_t frame, uint8_t code, int line)
+{
+  uint8_t key;
+  for (key = 0; key < NES_KEYBOARD_KEYS; ++key)
+  {
+    if (key_codes[key] == code)
+    {
+      add_event(frame, key, true);
+      add_event(frame + KEY_FRAMES, key, false);
+      return frame + 2 * KEY_FRAMES;
+    }
+  }
+  for (key = 0; key < NES_KEYBOARD_KEYS; ++key)
+  {
+    if (key_codes[key] != 0 && shifted(key_codes[key]) == code)
+    {
+      add_event(frame, SHIFT_KEY, true);
+      add_event(frame, key, true);
+      add_event(frame + KEY_FRAMES, key, false);
+      add_event(frame + KEY_FRAMES, SHIFT_KEY, false);
+      return frame + 2 * KEY_FRAMES;
+    }
+  }
+  fprintf(stderr, "line %d: no key types %c\n", line, code);
+  exit(1);
+}
+
+static bool load_script (const char *path)
+{
+  char line[1024];
+  uint64_t frame = 0;
+  int number = 0;
+  size_t i, len;
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    ++number;
+    len = strcspn(line, "\r\n");
+    line[len] = '\0';
+    if (len == 0 || line[0] == '#')
+    {
+      continue;
+    }
+    if (strncmp(line, "wait ", 5) == 0)
+    {
+      frame += strtoull(line + 5, NULL, 10);
+    }
+    else if (strncmp(line, "type ", 5) == 0)
+    {
+      for (i = 5; i < len; ++i)
+      {
+        frame = press(frame, (uint8_t)line[i], number);
+      }
+    }
+    else if (strncmp(line, "press ", 6) == 0)
+    {
+      for (i = 0; i < sizeof(key_names) / sizeof(key_names[0]) && strcmp(line + 6, key_names[i].name) != 0; ++i)
+      {
+      }
+      if (i == sizeof(key_names) / sizeof(key_names[0]))
+      {
+        fprintf(stderr, "%s:%d: no key is called %s\n", path, number, line + 6);
+        fclose(f);
+        return false;
+      }
+      frame = press(frame, key_names[i].code, number);
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: %s is not wait, type or press\n", path, number, line);
+      fclose(f);
+      return false;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool load_sav (const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  size_t read;
+  if (f == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  read = fread(nes.wram, 1, NES_WRAM_SIZE, f);
+  fclose(f);
+  if (read != NES_WRAM_SIZE)
+  {
+    fprintf(stderr, "%s: %zu bytes instead of %d\n", path, read, NES_WRAM_SIZE);
+    return false;
+  }
+  return true;
+}
+
+static int compare_cycles (const void *a, const void *b)
+{
+  const struct symbol *sa = *(const struct symbol *const *)a, *sb = *(const struct symbol *const *)b;
+  return sa->cycles < sb->cycles ? 1 : sa->cycles > sb->cycles ? -1 : strcmp(sa->name, sb->name);
+}
+
+static void report (const char *start, uint64_t total, uint64_t frames, uint64_t unknown)
+{
+  struct symbol **sorted = malloc(symbol_count * sizeof(*sorted));
+  size_t i, count = 0;
+  for (i = 0; i < symbol_count; ++i)
+  {
+    if (symbols[i].cycles != 0)
+    {
+      sorted[count++] = &symbols[i];
+    }
+  }
+  qsort(sorted, count, sizeof(*sorted), compare_cycles);
+
+  printf("# %s: %llu cycles, %llu frames\n", start, (unsigned long long)total, (unsigned long long)frames);
+  printf("%12s %7s %8s %10s  %s\n", "cycles", "percent", "calls", "per_call", "function");
+  for (i = 0; i < count; ++i)
+  {
+    printf("%12llu %7.2f %8llu %10llu  %s\n", (unsigned long long)sorted[i]->cycles, 100.0 * sorted[i]->cycles / total,
+           (unsigned long long)sorted[i]->calls,
+           (unsigned long long)(sorted[i]->calls ? sorted[i]->cycles / sorted[i]->calls : 0), sorted[i]->name);
+  }
+  if (unknown != 0)
+  {
+    printf("%12llu %7.2f %8s %10s  %s\n", (unsigned long long)unknown, 100.0 * unknown / total, "-", "-", "?");
+  }
+  free(sorted);
+}
+
+int main (int argc, char **argv)
+{
+  const char *dbg = NULL, *labels = NULL, *sav = NULL, *start = START_FUNCTION;
+  int opt, sym, start_sym = NO_SYMBOL;
+  size_t i, next_event = 0;
+  bool profiling = false;
+  uint8_t window_s = 0;
+  uint16_t pc;
+  unsigned cycles;
+  uint64_t total = 0, unknown = 0, first_frame = 0;
+
+  while ((opt = getopt(argc, argv, "d:l:s:f:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'd': dbg = optarg; break;
+    case 'l': labels = optarg; break;
+    case 's': sav = optarg; break;
+    case 'f': start = optarg; break;
+    default: usage(argv[0]);
+    }
+  }
+  if (optind + 2 != argc || (dbg == NULL && labels == NULL))
+  {
+    usage(argv[0]);
+  }
+  if (!nes_load(&nes, argv[optind]) || (sav != NULL && !load_sav(sav)) || !load_script(argv[optind + 1]) ||
+      (dbg != NULL && !load_dbg(dbg)) || (labels != NULL && !load_labels(labels)))
+  {
+    return 1;
+  }
+  map_symbols();
+  for (i = 0; i < symbol_count; ++i)
+  {
+    if (strcmp(symbols[i].name, start) == 0)
+    {
+      start_sym = (int)i;
+    }
+  }
+  if (start_sym == NO_SYMBOL)
+  {
+    fprintf(stderr, "%s has no label\n", start);
+    return 1;
+  }
+
+  while (nes.frame < MAX_FRAMES)
+  {
+    for (; next_event < event_count && events[next_event].frame <= nes.frame; ++next_event)
+    {
+      nes.keys[events[next_event].key] = events[next_event].down;
+    }
+
+    pc = nes.cpu.pc;
+    sym = owner(pc);
+    cycles = nes_step(&nes);
+    if (cycles == 0)
+    {
+      fprintf(stderr, "$%04X: opcode $%02X in bank %u is not an official one\n", pc, nes_read(&nes, pc), nes_bank(&nes, pc));
+      return 1;
+    }
+
+    // Calls are counted by where they land, the NMI is taken before the instruction at pc
+    if (nes.opcode == 0x20 || nes.opcode == NES_NMI)
+    {
+      if (nes.opcode == NES_NMI)
+      {
+        sym = owner(nes.cpu.pc);
+      }
+      if (!profiling && owner(nes.cpu.pc) == start_sym && nes.cpu.pc == symbols[start_sym].addr && nes.opcode == 0x20)
+      {
+        profiling = true;
+        window_s = nes.cpu.s;
+        first_frame = nes.frame;
+      }
+      if (profiling && owner(nes.cpu.pc) != NO_SYMBOL && nes.cpu.pc == symbols[owner(nes.cpu.pc)].addr)
+      {
+        ++symbols[owner(nes.cpu.pc)].calls;
+      }
+    }
+    if (!profiling)
+    {
+      continue;
+    }
+    total += cycles;
+    if (sym == NO_SYMBOL)
+    {
+      unknown += cycles;
+    }
+    else
+    {
+      symbols[sym].cycles += cycles;
+    }
+    if (nes.opcode == 0x60 && nes.cpu.s == (uint8_t)(window_s + 2))
+    {
+      report(start, total, nes.frame - first_frame, unknown);
+      return 0;
+    }
+  }
+
+  fprintf(stderr, "%s was %s after %d frames\n", start, profiling ? "still running" : "never called", MAX_FRAMES);
+  return 1;
+}
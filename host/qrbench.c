@@ -0,0 +1,181 @@
+#include "host_encoder.h"
+#include "build/capacity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Encodes payloads of every length step bytes apart, at every ECL and with every mask,
+// and prints one CSV line per combination: the settings, what the code came out as, a
+// hash of it to compare builds by, and the time each encoding took. The combinations
+// are shared among worker processes, as the encoder keeps its state in globals.
+
+#define MASKS 9 // qrcodegen_Mask_AUTO and qrcodegen_Mask_0 to 7
+#define SEED 1
+
+struct job
+{
+  uint16_t len;
+  uint8_t ecl;
+  int8_t mask;
+};
+
+struct result
+{
+  uint32_t job;
+  uint8_t ok;
+  uint8_t version;
+  uint8_t ecl;
+  uint8_t mask;
+  uint32_t hash;
+  double ns;
+};
+
+static struct job *jobs;
+static uint32_t job_count;
+static uint8_t payload[QR_CAPACITY_MAX_TEXT];
+
+static void usage (const char *name)
+{
+  fprintf(stderr, "Usage: %s [-j workers] [-r repeats] [-s length step] [-b]\n", name);
+  fprintf(stderr, "  -b turns bECL on\n");
+  exit(1);
+}
+
+static double now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Runs every workers-th job from first on, writing the results to fd
+static void work (uint32_t first, uint32_t workers, unsigned repeats, bool boost, int fd)
+{
+  uint32_t i;
+  unsigned r;
+  struct result result;
+  double start;
+
+  for (i = first; i < job_count; i += workers)
+  {
+    memset(&result, 0, sizeof(result));
+    result.job = i;
+    host_payload(payload, jobs[i].len, SEED + jobs[i].len);
+    start = now_ns();
+    for (r = 0; r < repeats; ++r)
+    {
+      result.ok = host_encode(payload, jobs[i].len, jobs[i].ecl, jobs[i].mask, boost);
+    }
+    result.ns = (now_ns() - start) / repeats;
+    if (result.ok)
+    {
+      result.version = (qrcodegen_getSize() - 17) / 4;
+      result.ecl = ecl;
+      result.mask = mask;
+      result.hash = host_hash();
+    }
+    if (write(fd, &result, sizeof(result)) != sizeof(result))
+    {
+      exit(1);
+    }
+  }
+}
+
+int main (int argc, char **argv)
+{
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned repeats = 3, step = 32;
+  bool boost = false;
+  int opt, fds[2];
+  uint32_t i, received = 0;
+  uint16_t len;
+  uint8_t e;
+  int8_t m;
+  long w;
+  struct result result, *results;
+  double start, total_ns = 0;
+
+  while ((opt = getopt(argc, argv, "j:r:s:b")) != -1)
+  {
+    switch (opt)
+    {
+    case 'j': workers = atol(optarg); break;
+    case 'r': repeats = (unsigned)atoi(optarg); break;
+    case 's': step = (unsigned)atoi(optarg); break;
+    case 'b': boost = true; break;
+    default: usage(argv[0]);
+    }
+  }
+  if (workers < 1 || repeats < 1 || step < 1 || optind != argc)
+  {
+    usage(argv[0]);
+  }
+
+  for (e = 0; e < 4; ++e)
+  {
+    job_count += (qr_capacity[e][QR_CAPACITY_MAX_VERSION] / step + 1) * MASKS;
+  }
+  jobs = calloc(job_count, sizeof(*jobs));
+  results = calloc(job_count, sizeof(*results));
+  job_count = 0;
+  for (e = 0; e < 4; ++e)
+  {
+    for (len = 0; len <= qr_capacity[e][QR_CAPACITY_MAX_VERSION]; len += step)
+    {
+      for (m = qrcodegen_Mask_AUTO; m <= qrcodegen_Mask_7; ++m)
+      {
+        jobs[job_count].len = len;
+        jobs[job_count].ecl = e;
+        jobs[job_count].mask = m;
+        ++job_count;
+      }
+    }
+  }
+
+  if (pipe(fds) != 0)
+  {
+    perror("pipe");
+    return 1;
+  }
+  start = now_ns();
+  for (w = 0; w < workers; ++w)
+  {
+    if (fork() == 0)
+    {
+      close(fds[0]);
+      work(w, workers, repeats, boost, fds[1]);
+      _exit(0);
+    }
+  }
+  close(fds[1]);
+  // Results fit in PIPE_BUF, so those of different workers never interleave
+  while (read(fds[0], &result, sizeof(result)) == sizeof(result))
+  {
+    results[result.job] = result;
+    ++received;
+  }
+  while (wait(NULL) > 0)
+  {
+  }
+  if (received != job_count)
+  {
+    fprintf(stderr, "%u of %u results came back\n", received, job_count);
+    return 1;
+  }
+
+  printf("len,ecl,mask,boost,ok,version,code_ecl,code_mask,hash,ns\n");
+  for (i = 0; i < job_count; ++i)
+  {
+    printf("%u,%c,%c,%c,%u,%u,%c,%u,%08x,%.0f\n", jobs[i].len, "LMQH"[jobs[i].ecl],
+           jobs[i].mask == qrcodegen_Mask_AUTO ? 'A' : '0' + jobs[i].mask, boost ? 'T' : 'F',
+           results[i].ok, results[i].version, "LMQH"[results[i].ecl], results[i].mask,
+           results[i].hash, results[i].ns);
+    total_ns += results[i].ns;
+  }
+  fprintf(stderr, "%u encodings x %u in %.2f s with %ld workers, %.3f ms per encoding on average\n",
+          job_count, repeats, (now_ns() - start) / 1e9, workers, total_ns / job_count / 1e6);
+  return 0;
+}
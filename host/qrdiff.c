@@ -0,0 +1,133 @@
+#include "host_encoder.h"
+#include "upstream.h"
+#include "build/capacity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Encodes payloads of every length step bytes apart with both the encoder of the ROM and
+// the upstream library, at every ECL, with every mask and with bECL off and on, and
+// reports every code that comes out different. Each code is also encoded again the way F1
+// does, after encoding the payload at the next ECL. Exits with 1 if any came out different.
+
+#define MAX_REPORTS 20
+
+static unsigned long checked, mismatched;
+static uint8_t payload[QR_CAPACITY_MAX_TEXT + 1];
+
+static void usage (const char *name)
+{
+  fprintf(stderr, "Usage: %s [-s length step] [-n payloads per length]\n", name);
+  exit(1);
+}
+
+// Returns the number of modules that differ, or -1 if the sizes do
+static int compare (void)
+{
+  int size = qrcodegen_getSize();
+  int x, y, diff = 0;
+  if (size != upstream_size())
+  {
+    return -1;
+  }
+  for (y = 0; y < size; ++y)
+  {
+    for (x = 0; x < size; ++x)
+    {
+      diff += qrcodegen_getModule(x, y) != upstream_module(x, y);
+    }
+  }
+  return diff;
+}
+
+// Checks every setting on seeds payloads of len bytes
+static void check_length (uint16_t len, enum qrcodegen_Ecc e, unsigned seeds)
+{
+  unsigned seed;
+  int m, boost, again, diff;
+  bool ours, theirs;
+
+  for (seed = 0; seed < seeds; ++seed)
+  {
+    host_payload(payload, len, seed * 65536 + len);
+    for (m = qrcodegen_Mask_AUTO; m <= qrcodegen_Mask_7; ++m)
+    {
+      for (boost = 0; boost < 2; ++boost)
+      {
+        theirs = upstream_encode(payload, len, e, m, boost, QR_CAPACITY_MAX_VERSION);
+        for (again = 0; again < 2; ++again)
+        {
+          if (again)
+          {
+            host_encode(payload, len, (e + 1) & 3, qrcodegen_Mask_AUTO, false);
+            ours = host_reencode(e, m, boost);
+          }
+          else
+          {
+            ours = host_encode(payload, len, e, m, boost);
+          }
+          diff = ours && theirs ? compare() : 0;
+          ++checked;
+          if (ours == theirs && diff == 0)
+          {
+            continue;
+          }
+          if (++mismatched <= MAX_REPORTS)
+          {
+            printf("len %u ecl %c mask %c bECL %c seed %u%s: ", len, "LMQH"[e],
+                   m == qrcodegen_Mask_AUTO ? 'A' : '0' + m, boost ? 'T' : 'F', seed,
+                   again ? " again" : "");
+            if (ours != theirs)
+            {
+              printf("encoded %s, upstream %s\n", ours ? "yes" : "no", theirs ? "yes" : "no");
+            }
+            else if (diff < 0)
+            {
+              printf("size %d, upstream %d\n", qrcodegen_getSize(), upstream_size());
+            }
+            else
+            {
+              printf("%d modules differ\n", diff);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+int main (int argc, char **argv)
+{
+  unsigned step = 7, seeds = 2;
+  int opt, e;
+  uint16_t len, max;
+
+  while ((opt = getopt(argc, argv, "s:n:")) != -1)
+  {
+    switch (opt)
+    {
+    case 's': step = (unsigned)atoi(optarg); break;
+    case 'n': seeds = (unsigned)atoi(optarg); break;
+    default: usage(argv[0]);
+    }
+  }
+  if (step < 1 || seeds < 1 || optind != argc)
+  {
+    usage(argv[0]);
+  }
+
+  for (e = qrcodegen_Ecc_LOW; e <= qrcodegen_Ecc_HIGH; ++e)
+  {
+    max = qr_capacity[e][QR_CAPACITY_MAX_VERSION];
+    for (len = 0; len < max; len += step)
+    {
+      check_length(len, e, seeds);
+    }
+    // The most that fits, and one more byte which both must refuse
+    check_length(max, e, seeds);
+    check_length(max + 1, e, seeds);
+  }
+
+  printf("%lu codes checked, %lu different\n", checked, mismatched);
+  return mismatched != 0;
+}
@@ -0,0 +1,39 @@
+import re
+import sys
+
+if len(sys.argv) != 3:
+  print('Usage:', sys.argv[0], '[rsmt.s input] [C output]')
+  sys.exit(1)
+
+BANKS = ['BANK0', 'BANK1', 'BANK2', 'BANK3']
+BANK_SIZE = 0x4000
+
+# The bytes of each bank of rsmt.s, in the order they are in the ROM
+banks = {}
+bank = None
+with open(sys.argv[1]) as asm_in:
+  for line in asm_in:
+    segment = re.match(r'\s*\.segment\s+"(\w+)"', line)
+    if segment:
+      bank = segment.group(1)
+      continue
+    data = re.match(r'\s*\.byte\s+(.*)', line)
+    if data and bank in BANKS:
+      banks.setdefault(bank, []).extend(int(b.strip().lstrip('$'), 16) for b in data.group(1).split(','))
+
+for name in BANKS:
+  if len(banks.get(name, [])) != BANK_SIZE:
+    print('{}: {} holds {} bytes instead of {}'.format(sys.argv[1], name, len(banks.get(name, [])), BANK_SIZE))
+    sys.exit(1)
+
+with open(sys.argv[2], 'w') as c_out:
+  c_out.write("""
+#include <stdint.h>
+
+// The product of x and y is at y * 256 + x, as _reedSolomonMultiply finds it in BANK0-3
+const uint8_t rsmt_table[{size}] = {{
+""".format(size=len(BANKS) * BANK_SIZE))
+  for name in BANKS:
+    for i in range(0, BANK_SIZE, 16):
+      c_out.write('  {},\n'.format(', '.join('0x{:0>2x}'.format(b) for b in banks[name][i:i + 16])))
+  c_out.write('};\n')
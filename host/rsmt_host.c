@@ -0,0 +1,21 @@
+#include <stdint.h>
+
+// The products of rsmt.s, as converted by rsmt2c.py
+extern const uint8_t rsmt_table[];
+
+// Stand-in for _reedSolomonMultiply of rsmt.s, which looks up the same table but has to
+// switch to its bank first
+uint8_t reedSolomonMultiply (uint8_t x, uint8_t y)
+{
+  return rsmt_table[(uint16_t)y << 8 | x];
+}
+
+// Stand-in for _reedSolomonMultiplyAdd of rsmt.s
+void reedSolomonMultiplyAdd (uint8_t result[], const uint8_t x[], uint8_t len, uint8_t y)
+{
+  uint8_t i;
+  for (i = 0; i < len; ++i)
+  {
+    result[i] ^= rsmt_table[(uint16_t)y << 8 | x[i]];
+  }
+}
@@ -0,0 +1,42 @@
+// Builds the upstream library under other names, so that it links next to the encoder
+// of the ROM, which keeps the qrcodegen_ ones. Only the public functions need renaming.
+#define qrcodegen_encodeText upstream_qrcodegen_encodeText
+#define qrcodegen_encodeBinary upstream_qrcodegen_encodeBinary
+#define qrcodegen_encodeSegments upstream_qrcodegen_encodeSegments
+#define qrcodegen_encodeSegmentsAdvanced upstream_qrcodegen_encodeSegmentsAdvanced
+#define qrcodegen_isNumeric upstream_qrcodegen_isNumeric
+#define qrcodegen_isAlphanumeric upstream_qrcodegen_isAlphanumeric
+#define qrcodegen_calcSegmentBufferSize upstream_qrcodegen_calcSegmentBufferSize
+#define qrcodegen_makeBytes upstream_qrcodegen_makeBytes
+#define qrcodegen_makeNumeric upstream_qrcodegen_makeNumeric
+#define qrcodegen_makeAlphanumeric upstream_qrcodegen_makeAlphanumeric
+#define qrcodegen_makeEci upstream_qrcodegen_makeEci
+#define qrcodegen_getSize upstream_qrcodegen_getSize
+#define qrcodegen_getModule upstream_qrcodegen_getModule
+
+#include "qrcodegen.c" // from the upstream c directory, see CMakeLists.txt
+#include "upstream.h"
+
+static uint8_t data_and_temp[qrcodegen_BUFFER_LEN_MAX];
+static uint8_t code[qrcodegen_BUFFER_LEN_MAX];
+
+bool upstream_encode (const uint8_t data[], size_t len, int ecl, int mask, bool boost, int max_version)
+{
+  if (len > sizeof(data_and_temp))
+  {
+    return false;
+  }
+  memcpy(data_and_temp, data, len);
+  return qrcodegen_encodeBinary(data_and_temp, len, code, (enum qrcodegen_Ecc)ecl,
+                                qrcodegen_VERSION_MIN, max_version, (enum qrcodegen_Mask)mask, boost);
+}
+
+int upstream_size (void)
+{
+  return qrcodegen_getSize(code);
+}
+
+bool upstream_module (int x, int y)
+{
+  return qrcodegen_getModule(code, x, y);
+}
@@ -0,0 +1,17 @@
+#if !defined(UPSTREAM_H_)
+#define UPSTREAM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The QR Code generator library as released, to check the encoder of the ROM against
+
+// Encodes data[0 : len] in byte mode into a code of version 1 to max_version, with the
+// ECL, mask and boost as the qrcodegen enums have them. Returns false if it does not fit.
+bool upstream_encode (const uint8_t data[], size_t len, int ecl, int mask, bool boost, int max_version);
+// Size and modules of the code from the last successful upstream_encode
+int upstream_size (void);
+bool upstream_module (int x, int y);
+
+#endif // UPSTREAM_H_
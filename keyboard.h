@@ -3,16 +3,37 @@
 
 #include <stdint.h>
 
+// Family BASIC keyboard driver, see keyboard.s
+
 #define KEYBOARD_NO_KEY '\000'
 #define KEYBOARD_F1 '\001'
 #define KEYBOARD_F2 '\002'
 #define KEYBOARD_F3 '\003'
+#define KEYBOARD_F4 '\006'
 #define KEYBOARD_F8 '\004'
 #define KEYBOARD_BACKSPACE '\b'
+#define KEYBOARD_RETURN '\n'
+#define KEYBOARD_LEFT '\021'
+#define KEYBOARD_RIGHT '\022'
+#define KEYBOARD_UP '\023'
+#define KEYBOARD_DOWN '\024'
+
+#define KEYBOARD_ROWS 9
 
+// Key taken from the queue by the last keyboard_poll, KEYBOARD_NO_KEY if it was empty
 extern uint8_t keyboard_key_pressed;
+// nesclock() at the end of the vblank whose scan queued keyboard_key_pressed
+extern uint8_t keyboard_key_clock;
+// Keys held at the last scan, one byte per matrix row with a set bit for each held key
+extern uint8_t keyboard_state[KEYBOARD_ROWS];
 
+// Starts the scanning of the keyboard, which the NMI handler then does every frame.
+// It queues every key pressed since the last scan, and repeats of the one held down
+// at the delay and rate set when building (see keyboard.s). Function keys never repeat.
 void fastcall keyboard_init (void);
+// Takes the next key from the queue
 void fastcall keyboard_poll (void);
+// Drops every key in the queue, those typed before a screen is left for another
+void fastcall keyboard_flush (void);
 
 #endif // KEYBOARD_H_
@@ -0,0 +1,438 @@
+;Family BASIC keyboard driver, see keyboard.h
+;included from crt0.s right after neslib.s, shares its zero page variables
+;
+;the matrix is 9 rows of 2 columns of 4 keys, scanned into a 72-bit bitmap of
+;one byte per row, column 0 in the high nibble, a set bit for a held key
+;XORing it with the bitmap of the previous scan gives the keys pressed since,
+;so every key pressed in the same frame is seen (n-key rollover), and each is
+;decoded into a typeahead queue that keyboard_poll hands out one key at a time
+;
+;the scan is done by the NMI handler every frame, whatever the main thread is
+;busy with, so the queue is a ring with a single writer for each index like
+;the one of vramq.s: the NMI adds keys and keyboard_poll removes them
+
+
+	.export _keyboard_init,_keyboard_poll,_keyboard_flush
+	.export _keyboard_key_pressed,_keyboard_key_clock,_keyboard_state
+
+KBD_ROWS		=9
+KBD_QUEUE_SIZE		=64	;power of 2, a few seconds of typing
+;the repeat timing can be given with --asm-define, see QRDEMO_REPEAT_DELAY in CMakeLists.txt
+.ifndef KBD_REPEAT_DELAY
+KBD_REPEAT_DELAY	=30	;frames before a held key repeats, 0 to never repeat
+.endif
+.ifndef KBD_REPEAT_RATE
+KBD_REPEAT_RATE		=4	;frames between repeats
+.endif
+	.assert KBD_REPEAT_DELAY >= 0 && KBD_REPEAT_DELAY < 256, error, "KBD_REPEAT_DELAY is not 0 to 255"
+	.assert KBD_REPEAT_RATE > 0 && KBD_REPEAT_RATE < 256, error, "KBD_REPEAT_RATE is not 1 to 255"
+KBD_NO_REPEAT		=$ff
+
+KBD_SHIFT		=$09
+KBD_DEBUG		=$05
+KBD_FIRST_REPEAT	=$08	;the function keys below it never repeat
+KBD_RSHIFT_ROW		=0
+KBD_RSHIFT_BIT		=$02
+KBD_LSHIFT_ROW		=7
+KBD_LSHIFT_BIT		=$01
+
+KBD_INPUT		=$4016
+KBD_OUTPUT		=$4017
+
+
+
+.segment "ZEROPAGE"
+
+KBD_BITS:		.res 1
+KBD_ANY:		.res 1
+KBD_SAVE_X:		.res 1
+KBD_ON:			.res 1	;set once keyboard_init is done, the NMI scans nothing until then
+KBD_HEAD:		.res 1	;next free entry, written by the NMI only
+KBD_TAIL:		.res 1	;next queued entry, written by the main thread only
+
+
+
+.segment "BSS"
+
+_keyboard_state:	.res KBD_ROWS
+_keyboard_key_pressed:	.res 1
+_keyboard_key_clock:	.res 1
+KBD_SCAN:		.res KBD_ROWS
+KBD_PRESSED:		.res KBD_ROWS
+KBD_QUEUE:		.res KBD_QUEUE_SIZE
+KBD_QUEUE_CLOCK:	.res KBD_QUEUE_SIZE	;FRAME_CNT1 at the scan that queued each key
+KBD_REPEAT_KEY:		.res 1	;matrix index of the key being repeated
+KBD_REPEAT_TIMER:	.res 1
+KBD_DEBUG_CHAR:		.res 1	;0 unless debug typing is on
+
+
+
+.segment "RODATA"
+
+;key codes by matrix index, row * 8 + column * 4 + (4 - data bit)
+
+kbd_keys:
+
+	.byte "][",$0a,$04,$00,$5c,KBD_SHIFT,$00
+	.byte ";:@",$00,"^-/_"
+	.byte "klo",$00,"0p,."
+	.byte "jui",$00,"89nm"
+	.byte "hgy",$06,"67vb"
+	.byte "drt",$03,"45cf"
+	.byte "asw",$02,"3ezx"
+	.byte $00,"q",$00,$01,"21",$00,KBD_SHIFT
+	.byte $11,$12,$13,$00,KBD_DEBUG,$08," ",$14
+
+kbd_bits:
+
+	.byte $80,$40,$20,$10,$08,$04,$02,$01
+
+
+
+.segment "CODE"
+
+;give the keyboard time to switch rows and columns before reading it
+
+.macro kbd_settle
+
+	ldy #5
+:
+	dey
+	bne :-
+
+.endmacro
+
+
+
+;void __fastcall__ keyboard_init(void);
+
+_keyboard_init:
+
+	lda #0
+	sta <KBD_ON
+	sta <KBD_HEAD
+	sta <KBD_TAIL
+	sta KBD_DEBUG_CHAR
+	lda #KBD_NO_REPEAT
+	sta KBD_REPEAT_KEY
+	inc <KBD_ON
+	rts
+
+
+
+;void __fastcall__ keyboard_flush(void);
+
+_keyboard_flush:
+
+	lda <KBD_HEAD		;moving the tail up to the head keeps its single writer
+	sta <KBD_TAIL
+	rts
+
+
+
+;void __fastcall__ keyboard_poll(void);
+
+_keyboard_poll:
+
+	lda #0
+	ldx <KBD_TAIL
+	cpx <KBD_HEAD
+	beq @1
+	inx
+	txa
+	and #KBD_QUEUE_SIZE-1
+	sta <KBD_TAIL
+	lda KBD_QUEUE_CLOCK-1,x
+	sta _keyboard_key_clock
+	lda KBD_QUEUE-1,x
+
+@1:
+
+	sta _keyboard_key_pressed
+	rts
+
+
+
+;scan the keyboard and queue the keys pressed since the last scan
+;called by the NMI handler every frame, after the vblank updates
+
+kbd_nmi:
+
+	lda <KBD_ON
+	bne @start
+	rts
+
+@start:
+
+	lda #$05			;row 0, column 0
+	sta KBD_INPUT
+	ldx #0
+
+@scan:
+
+	lda #$04			;column 0
+	sta KBD_INPUT
+	kbd_settle
+	lda KBD_OUTPUT
+	asl a
+	asl a
+	asl a
+	and #$f0
+	sta <KBD_BITS
+	lda #$06			;column 1, the next row comes with column 0 again
+	sta KBD_INPUT
+	kbd_settle
+	lda KBD_OUTPUT
+	lsr a
+	and #$0f
+	ora <KBD_BITS
+	eor #$ff			;keys read as 0 while held
+	sta KBD_SCAN,x
+	inx
+	cpx #KBD_ROWS
+	bne @scan
+
+	;past the last row the keyboard reads as all 1s, and as all 0s once
+	;disabled, which tells it apart from nothing being plugged in
+
+	lda #$04
+	sta KBD_INPUT
+	kbd_settle
+	lda KBD_OUTPUT
+	and #$1e
+	cmp #$1e
+	bne @absent
+	lda #$00
+	sta KBD_INPUT
+	kbd_settle
+	lda KBD_OUTPUT
+	and #$1e
+	bne @absent
+
+	lda #0
+	sta <KBD_ANY
+	ldx #KBD_ROWS-1
+
+@edges:
+
+	lda KBD_SCAN,x
+	eor _keyboard_state,x
+	and KBD_SCAN,x		;pressed since the last scan
+	sta KBD_PRESSED,x
+	ora <KBD_ANY
+	sta <KBD_ANY
+	lda KBD_SCAN,x
+	sta _keyboard_state,x
+	dex
+	bpl @edges
+
+	jsr kbd_debug
+	jsr kbd_repeat
+	lda <KBD_ANY
+	beq @done
+	jmp kbd_decode
+
+@absent:
+
+	lda #0
+	ldx #KBD_ROWS-1
+
+@clear:
+
+	sta _keyboard_state,x
+	dex
+	bpl @clear
+
+@done:
+
+	rts
+
+
+
+;queue every key in KBD_PRESSED, in matrix order
+
+kbd_decode:
+
+	ldx #0
+	ldy #0
+
+@row:
+
+	lda KBD_PRESSED,x
+	sta <KBD_BITS
+
+@bit:
+
+	asl <KBD_BITS
+	bcc @next
+	jsr kbd_press
+
+@next:
+
+	iny
+	tya
+	and #7
+	bne @bit
+	inx
+	cpx #KBD_ROWS
+	bne @row
+	rts
+
+
+
+;queue the key at matrix index Y and have it repeat, preserves X and Y
+
+kbd_press:
+
+	lda KBD_DEBUG_CHAR		;any key ends debug typing
+	beq @1
+	lda #0
+	sta KBD_DEBUG_CHAR
+	rts
+
+@1:
+
+	lda kbd_keys,y
+	beq @3
+	cmp #KBD_SHIFT
+	beq @3
+	cmp #KBD_DEBUG
+	bne @2
+	lda #'X'
+	sta KBD_DEBUG_CHAR
+	jmp kbd_push
+
+@2:
+
+	cmp #KBD_FIRST_REPEAT
+	bcc @4
+	lda #KBD_REPEAT_DELAY
+	beq @4
+	sta KBD_REPEAT_TIMER
+	sty KBD_REPEAT_KEY
+
+@4:
+
+	lda kbd_keys,y
+	jsr kbd_shift
+	jmp kbd_push
+
+@3:
+
+	rts
+
+
+
+;while debug typing is on, queue an X every frame, alternating its case
+
+kbd_debug:
+
+	lda KBD_DEBUG_CHAR
+	beq @1
+	eor #$20
+	sta KBD_DEBUG_CHAR
+	jmp kbd_push
+
+@1:
+
+	rts
+
+
+
+;queue the repeated key again every KBD_REPEAT_RATE frames, until it is released
+
+kbd_repeat:
+
+	ldy KBD_REPEAT_KEY
+	cpy #KBD_NO_REPEAT
+	beq @2
+	tya
+	lsr a
+	lsr a
+	lsr a
+	tax
+	tya
+	and #7
+	tay
+	lda _keyboard_state,x
+	and kbd_bits,y
+	beq @1
+	dec KBD_REPEAT_TIMER
+	bne @2
+	lda #KBD_REPEAT_RATE
+	sta KBD_REPEAT_TIMER
+	ldy KBD_REPEAT_KEY
+	lda kbd_keys,y
+	jsr kbd_shift
+	jmp kbd_push
+
+@1:
+
+	lda #KBD_NO_REPEAT
+	sta KBD_REPEAT_KEY
+
+@2:
+
+	rts
+
+
+
+;apply either shift key to the key code in A
+
+kbd_shift:
+
+	pha
+	lda _keyboard_state+KBD_RSHIFT_ROW
+	and #KBD_RSHIFT_BIT
+	bne @1
+	lda _keyboard_state+KBD_LSHIFT_ROW
+	and #KBD_LSHIFT_BIT
+	bne @1
+	pla
+	rts
+
+@1:
+
+	pla
+	cmp #$2c
+	bcc @3
+	cmp #$3c
+	bcs @2
+	eor #$10
+	rts
+
+@2:
+
+	cmp #'a'
+	bcc @3
+	cmp #'z'+1
+	bcs @3
+	eor #$20
+
+@3:
+
+	rts
+
+
+
+;add the key code in A to the queue, dropping it if the queue is full
+;preserves X and Y
+
+kbd_push:
+
+	stx <KBD_SAVE_X
+	ldx <KBD_HEAD
+	sta KBD_QUEUE,x
+	lda <FRAME_CNT1
+	sta KBD_QUEUE_CLOCK,x
+	inx
+	txa
+	and #KBD_QUEUE_SIZE-1
+	cmp <KBD_TAIL
+	beq @1
+	sta <KBD_HEAD
+
+@1:
+
+	ldx <KBD_SAVE_X
+	rts
@@ -0,0 +1,114 @@
+# Most bytes each memory area of mapper.cfg may use, the whole area if it is not listed.
+# The C stack grows down from the end of RAM into whatever the segments in it leave.
+budgets = {
+  'ZP': 0x100,
+  'RAM': 0x500 - 0x100, # keeps 256 bytes for the C stack
+  'XRAM': 0x1800,
+  'PRG': 0x3fc0,
+}
+# Symbols listed for each segment of the report, largest first, 0 for all of them
+symbols_per_segment = 0
+
+### DO NOT MODIFY BELOW ###
+
+import re
+import sys
+
+if len(sys.argv) != 5:
+  print('Usage:', sys.argv[0], '[mapper.cfg] [ld65 map] [ld65 dbg] [report output]')
+  print('Reports how much of each memory area, segment and symbol the ROM uses, and fails')
+  print('if an area is over its budget. The report is only written when none is.')
+  sys.exit(1)
+
+
+def number(value):
+  value = value.strip()
+  return int(value[1:], 16) if value.startswith('$') else int(value, 0)
+
+
+# Entries of a block of the linker config, as name and dictionary of attributes
+def cfg_block(cfg, block):
+  body = re.search(r'\b' + block + r'\s*\{(.*?)\}', cfg, re.S).group(1)
+  entries = []
+  for entry in body.split(';'):
+    if ':' not in entry:
+      continue
+    name, attributes = entry.split(':', 1)
+    entries.append((name.strip(), dict((key.strip(), value.strip()) for key, value in
+      (attribute.split('=', 1) for attribute in attributes.split(',') if '=' in attribute))))
+  return entries
+
+
+with open(sys.argv[1]) as cfg_in:
+  cfg = re.sub(r'#.*', '', cfg_in.read())
+areas = [(name, number(attributes['start']), number(attributes['size'])) for name, attributes in cfg_block(cfg, 'MEMORY')]
+# A segment with a run area takes room in both, like DATA copied from ROM to RAM
+segment_areas = dict((name, sorted(set([attributes['load'], attributes.get('run', attributes['load'])])))
+  for name, attributes in cfg_block(cfg, 'SEGMENTS'))
+
+# Start and size of each segment in the ROM, from the segment list of the map
+segments = {}
+with open(sys.argv[2]) as map_in:
+  in_list = False
+  for line in map_in:
+    if line.startswith('Segment list:'):
+      in_list = True
+    elif in_list:
+      fields = line.split()
+      if not fields and segments:
+        break
+      if len(fields) == 5 and re.fullmatch(r'[0-9A-F]{6}', fields[1]):
+        segments[fields[0]] = (int(fields[1], 16), int(fields[3], 16))
+
+# Labels by segment, each taking up to the next one or the end of its segment
+dbg_segments = {}
+labels = []
+with open(sys.argv[3]) as dbg_in:
+  for line in dbg_in:
+    kind, _, attributes = line.rstrip('\n').partition('\t')
+    attributes = dict(attribute.split('=', 1) for attribute in attributes.split(',') if '=' in attribute)
+    if kind == 'seg':
+      dbg_segments[attributes['id']] = attributes['name'].strip('"')
+    elif kind == 'sym' and attributes.get('type') == 'lab' and 'seg' in attributes:
+      labels.append((attributes['seg'], int(attributes['val'], 16), attributes['name'].strip('"')))
+
+symbols = {}
+for seg_id, value, name in sorted(labels):
+  symbols.setdefault(dbg_segments[seg_id], []).append([name, value, 0])
+for segment, seg_symbols in symbols.items():
+  start, size = segments.get(segment, (0, 0))
+  ends = [value for _, value, _ in seg_symbols[1:]] + [start + size]
+  for symbol, end in zip(seg_symbols, ends):
+    symbol[2] = end - symbol[1]
+
+over = []
+report = []
+summary = ['%-12s %6s %6s %6s %6s' % ('area', 'size', 'used', 'free', 'budget')]
+for area, start, size in areas:
+  area_segments = sorted((segment for segment in segments if area in segment_areas.get(segment, [])),
+    key=lambda segment: -segments[segment][1])
+  used = sum(segments[segment][1] for segment in area_segments)
+  budget = budgets.get(area, size)
+  line = '%-12s %6d %6d %6d %6d' % (area, size, used, size - used, budget)
+  if used > budget:
+    over.append(area)
+    line += ' OVER BY %d' % (used - budget)
+  summary.append(line)
+
+  report.append('')
+  report.append('%s: $%04X-$%04X, %d of %d bytes used, %d free, budget %d' % (area, start, start + size - 1, used, size, size - used, budget))
+  for segment in area_segments:
+    seg_start, seg_size = segments[segment]
+    report.append('  %-10s $%04X %6d' % (segment, seg_start, seg_size))
+    seg_symbols = sorted(symbols.get(segment, []), key=lambda symbol: (-symbol[2], symbol[0]))
+    for name, value, symbol_size in seg_symbols[:symbols_per_segment or None]:
+      report.append('    %-32s $%04X %6d' % (name, value, symbol_size))
+
+print('\n'.join(summary))
+if over:
+  print('\n'.join(report))
+  print('Over budget:', ', '.join(over), file=sys.stderr)
+  sys.exit(1)
+
+with open(sys.argv[4], 'w') as report_out:
+  report_out.write('\n'.join(summary + report) + '\n')
@@ -88,6 +88,9 @@ unsigned char __fastcall__ ppu_system(void);
 // Return an 8-bit counter incremented at each vblank
 unsigned char __fastcall__ nesclock(void);
 
+// Return a 16-bit counter incremented at each vblank, nesclock() being its low byte
+unsigned int __fastcall__ nesclock16(void);
+
 // get/set the internal ppu ctrl cache var for manual writing
 unsigned char __fastcall__ get_ppu_ctrl_var(void);
 void __fastcall__ set_ppu_ctrl_var(unsigned char var);
@@ -165,6 +168,16 @@ void __fastcall__ bank_spr(unsigned char n);
 // select current chr bank for background, 0..1
 void __fastcall__ bank_bg(unsigned char n);
 
+// select chr bank for background below the sprite 0 hit, 0..1, or any other value to not split
+// the switch is done by the NMI handler, so it keeps working while the program is busy,
+// but all CPU time between the vblank and the sprite 0 hit is spent waiting for it
+void __fastcall__ bank_bg_split(unsigned char n);
+
+// set scroll below the sprite 0 hit, same as scroll does, or any y past 479 to not split
+// like bank_bg_split it is done by the NMI handler, both can be used together.
+// the new scroll lands around the start of the scanline after the hit, which shows line y
+void __fastcall__ scroll_split(unsigned int x, unsigned int y);
+
 
 
 // get random number 0..255 or 0..65535
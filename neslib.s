@@ -9,7 +9,7 @@
 	.export _oam_clear,_oam_size,_oam_spr,_oam_meta_spr,_oam_hide_rest
 	.export _ppu_wait_frame,_ppu_wait_nmi
 	.export _scroll,_split
-	.export _bank_spr,_bank_bg
+	.export _bank_spr,_bank_bg,_bank_bg_split,_scroll_split
 	.export _vram_read,_vram_write
 	; .export _music_play,_music_stop,_music_pause
 	.export _sfx_play,_sample_play
@@ -19,12 +19,14 @@
 	.export _set_vram_update,_flush_vram_update
 	.export _memfill,_delay
 	.export _get_ppu_ctrl_var,_set_ppu_ctrl_var
-	.export _nesclock
+	.export _nesclock,_nesclock16
 
 
 
 ;NMI handler
 
+SPLIT_TIMEOUT		=6	;blocks of 256 wait passes, past the lowest split around scanline 140
+
 nmi:
 	pha
 	txa
@@ -32,6 +34,14 @@ nmi:
 	tya
 	pha
 
+	lda <NMI_BUSY		;an NMI that comes while the last one still runs returns at once
+	beq @notBusy
+	jmp @busy
+
+@notBusy:
+
+	inc <NMI_BUSY
+
 	lda <PPU_MASK_VAR	;if rendering is disabled, do not access the VRAM at all
 	and #%00011000
 	bne @doUpdate
@@ -98,6 +108,8 @@ nmi:
 
 @skipUpd:
 
+	jsr vramq_nmi
+
 	lda #0
 	sta PPU_ADDR
 	sta PPU_ADDR
@@ -116,6 +128,11 @@ nmi:
 	sta PPU_MASK
 
 	inc <FRAME_CNT1
+	bne @skipHigh
+	inc <FRAME_CNT1_HIGH
+
+@skipHigh:
+
 	inc <FRAME_CNT2
 	lda <FRAME_CNT2
 	cmp #6
@@ -127,6 +144,61 @@ nmi:
 
 	; jsr FamiToneUpdate
 
+	lda <BG_SPLIT		;switch the bg pattern table and the scroll at the sprite 0 hit if needed
+	ora <SCROLL_SPLIT
+	beq @skipSplit
+	lda <PPU_MASK_VAR
+	and #%00011000
+	cmp #%00011000
+	bne @skipSplit
+	lda <PPU_CTRL_VAR
+	eor <BG_SPLIT
+	and #%00010000
+	eor <PPU_CTRL_VAR
+	tax
+
+@splitWait0:
+
+	bit PPU_STATUS
+	bvs @splitWait0
+
+	lda #SPLIT_TIMEOUT	;13 cycles a pass, so about 29 scanlines every 256 passes
+	sta <SPLIT_WAIT
+	ldy #0
+
+@splitWait1:
+
+	bit PPU_STATUS
+	bvs @splitHit
+	bmi @skipSplit
+	dey
+	bne @splitWait1
+	dec <SPLIT_WAIT
+	bne @splitWait1
+	beq @skipSplit		;no hit in this frame, give up well before vblank
+
+@splitHit:
+
+	stx PPU_CTRL
+	ldy <SCROLL_SPLIT	;the second PPU_ADDR write sets the whole address at once
+	beq @skipSplit
+	sty PPU_ADDR
+	lda <SCROLL_SPLIT+1
+	sta PPU_SCROLL
+	lda <SCROLL_SPLIT+2
+	sta PPU_SCROLL
+	lda <SCROLL_SPLIT+3
+	sta PPU_ADDR
+
+@skipSplit:
+
+	jsr kbd_nmi		;scan the keyboard, once the split is done as it takes a while
+
+	lda #0
+	sta <NMI_BUSY
+
+@busy:
+
 	pla
 	tay
 	pla
@@ -705,6 +777,92 @@ _bank_bg:
 
 
 
+;void __fastcall__ bank_bg_split(unsigned char n);
+
+_bank_bg_split:
+
+	cmp #2
+	bcs @1
+	asl a
+	asl a
+	asl a
+	asl a
+	ora #$80
+	sta <BG_SPLIT
+	rts
+
+@1:
+
+	lda #0
+	sta <BG_SPLIT
+	rts
+
+
+
+;void __fastcall__ scroll_split(unsigned int x,unsigned int y);
+
+_scroll_split:
+
+	sta <TEMP
+	stx <TEMP+1
+	jsr popax
+	sta <TEMP+2
+	txa
+	and #$01
+	ora #$20		;$80 once shifted into place
+	sta <TEMP+3
+
+	lda <TEMP+1
+	bne @1
+	lda <TEMP
+	cmp #240
+	bcc @2
+
+@1:
+
+	lda <TEMP
+	sec
+	sbc #240
+	sta <TEMP
+	lda <TEMP+1
+	sbc #0
+	bne @3
+	lda <TEMP
+	cmp #240
+	bcs @3
+	lda <TEMP+3
+	ora #$02
+	sta <TEMP+3
+
+@2:
+
+	lda <TEMP
+	sta <SCROLL_SPLIT+1
+	and #$f8
+	asl a
+	asl a
+	sta <TEMP+1
+	lda <TEMP+2
+	sta <SCROLL_SPLIT+2
+	lsr a
+	lsr a
+	lsr a
+	ora <TEMP+1
+	sta <SCROLL_SPLIT+3
+	lda <TEMP+3
+	asl a
+	asl a
+	sta <SCROLL_SPLIT
+	rts
+
+@3:
+
+	lda #0
+	sta <SCROLL_SPLIT
+	rts
+
+
+
 ;void __fastcall__ vram_read(unsigned char *dst,unsigned int size);
 
 _vram_read:
@@ -1188,6 +1346,17 @@ _nesclock:
 	ldx #$00
 	rts
 
+
+
+;unsigned int __fastcall__ nesclock16(void);
+
+_nesclock16:
+	ldx <FRAME_CNT1_HIGH
+	lda <FRAME_CNT1
+	cpx <FRAME_CNT1_HIGH	;read again if the NMI carried in between
+	bne _nesclock16
+	rts
+
 ;void __fastcall__ delay(unsigned char frames);
 
 _delay:
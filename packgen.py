@@ -0,0 +1,432 @@
+# Settings every payload is encoded with, as on the editor screen
+ecl = 'M' # L, M, Q or H
+mask = 'A' # 0-7, or A for the best one
+boost_ecl = True
+# Highest QR Code version to support, max_version of capgen.py
+max_version = 27
+# ROM banks the codes go in, in order, 16KB each
+banks = ['BANK5', 'BANK6']
+# Characters of the label shown for each code on the pack screen
+label_width = 28
+# Codes the pack screen lists, one per row
+max_codes = 26
+
+### DO NOT MODIFY BELOW ###
+
+import re
+import sys
+
+if len(sys.argv) != 4:
+  print('Usage:', sys.argv[0], '[payload input] [header output] [asm output]')
+  print('Each line of the payload input is a label, a tab, and the text to encode, in which')
+  print('\\n, \\t and \\\\ stand for a line feed, a tab and a backslash. Empty lines and lines')
+  print('starting with # are skipped.')
+  sys.exit(1)
+
+BANK_SIZE = 0x4000
+ESCAPES = {b'n': b'\n', b't': b'\t', b'\\': b'\\'}
+MAX_TILES = 255 # tile ID 0 is the blank tile
+
+# Same tables as qrcodegen.c, by ECC level (L, M, Q, H) and version
+ECC_CODEWORDS_PER_BLOCK = [
+  [-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30],
+  [-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28],
+  [-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30],
+  [-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30],
+]
+NUM_ERROR_CORRECTION_BLOCKS = [
+  [-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25],
+  [-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49],
+  [-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68],
+  [-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81],
+]
+
+MASK_FUNCTIONS = [
+  lambda x, y: (x + y) % 2 == 0,
+  lambda x, y: y % 2 == 0,
+  lambda x, y: x % 3 == 0,
+  lambda x, y: (x + y) % 3 == 0,
+  lambda x, y: (x // 3 + y // 2) % 2 == 0,
+  lambda x, y: x * y % 2 + x * y % 3 == 0,
+  lambda x, y: (x * y % 2 + x * y % 3) % 2 == 0,
+  lambda x, y: ((x + y) % 2 + x * y % 3) % 2 == 0,
+]
+
+PENALTY_N1 = 3
+PENALTY_N2 = 3
+PENALTY_N3 = 40
+PENALTY_N4 = 10
+
+def raw_data_modules(ver):
+  result = (16 * ver + 128) * ver + 64
+  if ver >= 2:
+    num_align = ver // 7 + 2
+    result -= (25 * num_align - 10) * num_align - 55
+    if ver >= 7:
+      result -= 36
+  return result
+
+def data_codewords(ecl, ver):
+  return raw_data_modules(ver) // 8 - ECC_CODEWORDS_PER_BLOCK[ecl][ver] * NUM_ERROR_CORRECTION_BLOCKS[ecl][ver]
+
+def byte_capacity(ecl, ver):
+  char_count_bits = 8 if ver < 10 else 16
+  return min((data_codewords(ecl, ver) * 8 - 4 - char_count_bits) // 8, (1 << char_count_bits) - 1)
+
+def rs_multiply(x, y):
+  z = 0
+  for i in range(7, -1, -1):
+    z = ((z << 1) ^ ((z >> 7) * 0x11d)) & 0xff
+    z ^= ((y >> i) & 1) * x
+  return z
+
+def rs_divisor(degree):
+  result = [0] * (degree - 1) + [1]
+  root = 1
+  for _ in range(degree):
+    for j in range(degree):
+      result[j] = rs_multiply(result[j], root)
+      if j + 1 < degree:
+        result[j] ^= result[j + 1]
+    root = rs_multiply(root, 0x02)
+  return result
+
+def rs_remainder(data, divisor):
+  result = [0] * len(divisor)
+  for b in data:
+    factor = b ^ result.pop(0)
+    result.append(0)
+    for i, coef in enumerate(divisor):
+      result[i] ^= rs_multiply(coef, factor)
+  return result
+
+def alignment_positions(ver):
+  if ver == 1:
+    return []
+  num_align = ver // 7 + 2
+  step = 26 if ver == 32 else (ver * 4 + num_align * 2 + 1) // (num_align * 2 - 2) * 2
+  result = [6] + [0] * (num_align - 1)
+  pos = ver * 4 + 10
+  for i in range(num_align - 1, 0, -1):
+    result[i] = pos
+    pos -= step
+  return result
+
+class QrCode:
+  """Byte mode encoder following qrcodegen.c, down to how it picks the version, ECL and mask"""
+
+  def __init__(self, text, ecl, mask, boost_ecl):
+    versions = [v for v in range(1, max_version + 1) if len(text) <= byte_capacity(ecl, v)]
+    if not versions:
+      raise ValueError('{} bytes do not fit in version {} at ECL {}'.format(len(text), max_version, 'LMQH'[ecl]))
+    self.version = versions[0]
+    for i in range(1, 4):
+      if boost_ecl and len(text) <= byte_capacity(i, self.version):
+        ecl = i
+    self.ecl = ecl
+    self.size = self.version * 4 + 17
+    self.modules = [[False] * self.size for _ in range(self.size)]
+    self.is_function = [[False] * self.size for _ in range(self.size)]
+
+    self._draw_function_patterns()
+    self._draw_codewords(self._add_ecc_and_interleave(self._data_codewords(text)))
+
+    if mask < 0:
+      # Same start and 16-bit sum as getPenaltyScore, for the same pick on ties
+      min_penalty = 0x7fff
+      for i in range(8):
+        self._apply_mask(i)
+        self._draw_format_bits(i)
+        penalty = self._penalty_score()
+        if penalty < min_penalty:
+          mask = i
+          min_penalty = penalty
+        self._apply_mask(i)
+    self.mask = mask
+    self._apply_mask(mask)
+    self._draw_format_bits(mask)
+
+  def _data_codewords(self, text):
+    bits = []
+    def append(val, n):
+      bits.extend((val >> i) & 1 for i in range(n - 1, -1, -1))
+    append(0x4, 4)
+    append(len(text), 8 if self.version < 10 else 16)
+    for b in text:
+      append(b, 8)
+    capacity_bits = data_codewords(self.ecl, self.version) * 8
+    append(0, min(4, capacity_bits - len(bits)))
+    append(0, -len(bits) % 8)
+    pad = 0xec
+    while len(bits) < capacity_bits:
+      append(pad, 8)
+      pad ^= 0xec ^ 0x11
+    return [int(''.join(str(b) for b in bits[i:i + 8]), 2) for i in range(0, len(bits), 8)]
+
+  def _add_ecc_and_interleave(self, data):
+    num_blocks = NUM_ERROR_CORRECTION_BLOCKS[self.ecl][self.version]
+    block_ecc_len = ECC_CODEWORDS_PER_BLOCK[self.ecl][self.version]
+    raw_codewords = raw_data_modules(self.version) // 8
+    num_short_blocks = num_blocks - raw_codewords % num_blocks
+    short_block_len = raw_codewords // num_blocks
+    divisor = rs_divisor(block_ecc_len)
+    blocks = []
+    k = 0
+    for i in range(num_blocks):
+      dat = data[k:k + short_block_len - block_ecc_len + (0 if i < num_short_blocks else 1)]
+      k += len(dat)
+      ecc = rs_remainder(dat, divisor)
+      if i < num_short_blocks:
+        dat.append(0)
+      blocks.append(dat + ecc)
+    result = []
+    for i in range(len(blocks[0])):
+      for j, block in enumerate(blocks):
+        if i != short_block_len - block_ecc_len or j >= num_short_blocks:
+          result.append(block[i])
+    return result
+
+  def _set_function(self, x, y, dark):
+    self.modules[y][x] = dark
+    self.is_function[y][x] = True
+
+  def _draw_function_patterns(self):
+    for i in range(self.size):
+      self._set_function(6, i, i % 2 == 0)
+      self._set_function(i, 6, i % 2 == 0)
+    for cx, cy in ((3, 3), (self.size - 4, 3), (3, self.size - 4)):
+      for dy in range(-4, 5):
+        for dx in range(-4, 5):
+          x, y = cx + dx, cy + dy
+          if 0 <= x < self.size and 0 <= y < self.size:
+            self._set_function(x, y, max(abs(dx), abs(dy)) not in (2, 4))
+    positions = alignment_positions(self.version)
+    last = len(positions) - 1
+    for i, px in enumerate(positions):
+      for j, py in enumerate(positions):
+        if (i, j) not in ((0, 0), (0, last), (last, 0)):
+          for dy in range(-2, 3):
+            for dx in range(-2, 3):
+              self._set_function(px + dx, py + dy, max(abs(dx), abs(dy)) != 1)
+    self._draw_format_bits(0)
+    if self.version >= 7:
+      rem = self.version
+      for _ in range(12):
+        rem = (rem << 1) ^ ((rem >> 11) * 0x1f25)
+      bits = self.version << 12 | rem
+      for i in range(18):
+        a, b = self.size - 11 + i % 3, i // 3
+        self._set_function(a, b, (bits >> i) & 1 != 0)
+        self._set_function(b, a, (bits >> i) & 1 != 0)
+
+  def _draw_format_bits(self, mask):
+    data = [1, 0, 3, 2][self.ecl] << 3 | mask
+    rem = data
+    for _ in range(10):
+      rem = (rem << 1) ^ ((rem >> 9) * 0x537)
+    bits = (data << 10 | rem) ^ 0x5412
+    bit = lambda i: (bits >> i) & 1 != 0
+    for i in range(6):
+      self._set_function(8, i, bit(i))
+    self._set_function(8, 7, bit(6))
+    self._set_function(8, 8, bit(7))
+    self._set_function(7, 8, bit(8))
+    for i in range(9, 15):
+      self._set_function(14 - i, 8, bit(i))
+    for i in range(8):
+      self._set_function(self.size - 1 - i, 8, bit(i))
+    for i in range(8, 15):
+      self._set_function(8, self.size - 15 + i, bit(i))
+    self._set_function(8, self.size - 8, True)
+
+  def _draw_codewords(self, codewords):
+    i = 0
+    right = self.size - 1
+    while right >= 1:
+      if right == 6:
+        right = 5
+      for vert in range(self.size):
+        for j in range(2):
+          x = right - j
+          upward = (right + 1) & 2 == 0
+          y = self.size - 1 - vert if upward else vert
+          if not self.is_function[y][x] and i < len(codewords) * 8:
+            self.modules[y][x] = (codewords[i >> 3] >> (7 - (i & 7))) & 1 != 0
+            i += 1
+      right -= 2
+
+  def _apply_mask(self, mask):
+    for y in range(self.size):
+      for x in range(self.size):
+        if not self.is_function[y][x] and MASK_FUNCTIONS[mask](x, y):
+          self.modules[y][x] = not self.modules[y][x]
+
+  def _penalty_score(self):
+    result = 0
+    lines = self.modules + [list(column) for column in zip(*self.modules)]
+    for line in lines:
+      run_color = False
+      run = 0
+      history = [0] * 7
+      for color in line:
+        if color == run_color:
+          run += 1
+          if run == 5:
+            result += PENALTY_N1
+          elif run > 5:
+            result += 1
+        else:
+          self._add_history(run, history)
+          if not run_color:
+            result += self._count_patterns(history) * PENALTY_N3
+          run_color = color
+          run = 1
+      if run_color:
+        self._add_history(run, history)
+        run = 0
+      self._add_history(run + self.size, history)
+      result += self._count_patterns(history) * PENALTY_N3
+
+    for y in range(self.size - 1):
+      for x in range(self.size - 1):
+        color = self.modules[y][x]
+        if color == self.modules[y][x + 1] == self.modules[y + 1][x] == self.modules[y + 1][x + 1]:
+          result += PENALTY_N2
+
+    dark = sum(sum(row) for row in self.modules)
+    total = self.size * self.size
+    k = (abs(dark * 20 - total * 10) + total - 1) // total - 1
+    result += k * PENALTY_N4
+    return result & 0xffff
+
+  def _add_history(self, run, history):
+    if history[0] == 0:
+      run += self.size
+    history.insert(0, run)
+    history.pop()
+
+  @staticmethod
+  def _count_patterns(history):
+    n = history[1]
+    core = n > 0 and history[2] == n and history[3] == n * 3 and history[4] == n and history[5] == n
+    return (1 if core and history[0] >= n * 4 and history[6] >= n else 0) \
+      + (1 if core and history[6] >= n * 4 and history[0] >= n else 0)
+
+def build_tiles(qr):
+  """Tile map and patterns the way qr_tiles.c builds them: ID 0 for the blank tile, then
+  one ID per distinct pattern in the order they come, only the low plane of each"""
+  side = (qr.size + 7) // 8
+  patterns = []
+  tile_map = []
+  for ty in range(side):
+    for tx in range(side):
+      tile = bytes(sum(0x80 >> c for c in range(8)
+                       if tx * 8 + c < qr.size and ty * 8 + r < qr.size and qr.modules[ty * 8 + r][tx * 8 + c])
+                   for r in range(8))
+      if not any(tile):
+        tile_map.append(0)
+        continue
+      if tile not in patterns:
+        patterns.append(tile)
+      tile_map.append(patterns.index(tile) + 1)
+  return side, tile_map, patterns
+
+def asm_bytes(data):
+  return ''.join('  .byte {}\n'.format(','.join('${:0>2x}'.format(c) for c in data[i:i + 16]))
+                 for i in range(0, len(data), 16))
+
+settings_ecl = 'LMQH'.index(ecl)
+settings_mask = -1 if mask == 'A' else int(mask)
+
+entries = []
+with open(sys.argv[1], 'rb') as payload_in:
+  for line_number, line in enumerate(payload_in.read().split(b'\n'), 1):
+    line = line.rstrip(b'\r')
+    if not line or line.startswith(b'#'):
+      continue
+    if b'\t' not in line:
+      print('{}:{}: no tab between the label and the text'.format(sys.argv[1], line_number))
+      sys.exit(1)
+    label, text = line.split(b'\t', 1)
+    try:
+      text = re.sub(rb'\\(.?)', lambda m: ESCAPES[m.group(1)], text)
+    except KeyError:
+      print('{}:{}: unknown escape in the text'.format(sys.argv[1], line_number))
+      sys.exit(1)
+    if len(label) > label_width:
+      print('{}:{}: label longer than {} characters'.format(sys.argv[1], line_number, label_width))
+      sys.exit(1)
+    try:
+      qr = QrCode(text, settings_ecl, settings_mask, boost_ecl)
+    except ValueError as e:
+      print('{}:{}: {}'.format(sys.argv[1], line_number, e))
+      sys.exit(1)
+    side, tile_map, patterns = build_tiles(qr)
+    # The pack screen has no split to fall back on like the QR screen
+    if len(patterns) > MAX_TILES:
+      print('{}:{}: {} distinct tiles, at most {} fit in a pattern table'.format(sys.argv[1], line_number, len(patterns), MAX_TILES))
+      sys.exit(1)
+    entries.append((label.ljust(label_width), qr, side, tile_map, patterns))
+
+if not entries or len(entries) > max_codes:
+  print('{}: {} codes, there must be 1 to {}'.format(sys.argv[1], len(entries), max_codes))
+  sys.exit(1)
+
+# First fit, in the order of the list
+bank_free = [BANK_SIZE] * len(banks)
+placement = []
+for number, (label, qr, side, tile_map, patterns) in enumerate(entries):
+  size = len(patterns) * 8 + len(tile_map)
+  bank = next((b for b in range(len(banks)) if bank_free[b] >= size), None)
+  if bank is None:
+    print('{}: no room left in {} for code {}'.format(sys.argv[1], ', '.join(banks), number))
+    sys.exit(1)
+  bank_free[bank] -= size
+  placement.append(bank)
+
+with open(sys.argv[2], 'w') as header_out:
+  header_out.write("""
+#if !defined(PACK_H_)
+#define PACK_H_
+
+#include <stdint.h>
+
+#define QR_PACK_COUNT {count}
+#define QR_PACK_LABEL_WIDTH {label_width}
+
+// A code encoded ahead of time by packgen.py, to be shown as it is
+struct qr_pack_entry
+{{
+  uint8_t label[QR_PACK_LABEL_WIDTH]; // padded with spaces
+  uint8_t bank; // PRG bank holding tiles and map
+  uint8_t side; // tiles per row and per column of the symbol
+  uint8_t tile_count; // patterns in tiles, for tile IDs 1 and up
+  uint8_t version;
+  uint8_t ecl;
+  uint8_t mask;
+  const uint8_t *tiles; // low plane of each pattern, 8 bytes per tile
+  const uint8_t *map; // tile ID of each position of the symbol, side IDs per row
+}};
+
+extern const struct qr_pack_entry qr_pack[QR_PACK_COUNT];
+
+#endif // PACK_H_
+""".format(count=len(entries), label_width=label_width))
+
+with open(sys.argv[3], 'w') as asm_out:
+  asm_out.write("""
+.segment "RODATA"
+  .export _qr_pack
+_qr_pack:
+""")
+  for number, (label, qr, side, tile_map, patterns) in enumerate(entries):
+    asm_out.write(asm_bytes(label))
+    asm_out.write('  .byte {},{},{},{},{},{}\n'.format(int(banks[placement[number]][4:]), side, len(patterns), qr.version, qr.ecl, qr.mask))
+    asm_out.write('  .addr qr_pack_tiles_{0},qr_pack_map_{0}\n'.format(number))
+
+  for number, (label, qr, side, tile_map, patterns) in enumerate(entries):
+    asm_out.write("""
+.segment "{bank}"
+qr_pack_tiles_{number}:
+{tiles}qr_pack_map_{number}:
+{tile_map}""".format(bank=banks[placement[number]], number=number, tiles=asm_bytes(b''.join(patterns)), tile_map=asm_bytes(tile_map)))
@@ -0,0 +1,87 @@
+#include "qr_cache.h"
+#include "screen.h"
+#include "build/capacity.h"
+
+#define MAGIC 0x5152 // "QR"
+
+#pragma bss-name (push, "WRAM")
+
+static struct
+{
+  uint16_t magic; // MAGIC if the rest is valid
+  uint16_t len;
+  enum qrcodegen_Ecc ecl;
+  enum qrcodegen_Mask mask;
+  bool boost;
+  uint16_t hash; // of the text and the settings above
+} key;
+
+#pragma bss-name (pop)
+
+static struct
+{
+  uint16_t hash;
+  const uint8_t *src;
+  uint16_t i;
+} d;
+
+static uint16_t fastcall _hash (uint16_t len);
+
+bool qr_cache_lookup (void)
+{
+  return key.magic == MAGIC
+    && key.len == dataLen
+    && key.ecl == ecl
+    && key.mask == mask
+    && key.boost == boostEcl
+    && key.hash == _hash(dataLen);
+}
+
+void qr_cache_store (void)
+{
+  key.magic = 0;
+  key.len = dataLen;
+  key.ecl = ecl;
+  key.mask = mask;
+  key.boost = boostEcl;
+  key.hash = _hash(dataLen);
+  key.magic = MAGIC;
+}
+
+void qr_cache_invalidate (void)
+{
+  key.magic = 0;
+}
+
+bool qr_cache_restore (void)
+{
+  if (key.magic != MAGIC)
+  {
+    return false;
+  }
+
+  // The settings are worth keeping even if the text was edited since
+  ecl = key.ecl;
+  mask = key.mask;
+  boostEcl = key.boost;
+  if (key.len > QR_CAPACITY_MAX_TEXT || key.hash != _hash(key.len))
+  {
+    return false;
+  }
+  dataLen = key.len;
+  return true;
+}
+
+// Hashes len bytes of text, then ecl, mask and boostEcl
+static uint16_t fastcall _hash (uint16_t len)
+{
+  d.hash = len;
+  d.src = text;
+  for (d.i = len; d.i != 0; --d.i)
+  {
+    d.hash = (d.hash << 5) - d.hash + *d.src++;
+  }
+  d.hash = (d.hash << 5) - d.hash + ecl;
+  d.hash = (d.hash << 5) - d.hash + mask;
+  return (d.hash << 5) - d.hash + boostEcl;
+}
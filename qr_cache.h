@@ -0,0 +1,21 @@
+#if !defined(QR_CACHE_H_)
+#define QR_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Remembers which text and settings the QR Code left in qrcode and tempBuffer was made
+// from. It is kept in battery-backed WRAM along with them, so it survives power cycles.
+
+// Tells whether qrcode holds the QR Code of the current text, ecl, mask and boostEcl
+bool qr_cache_lookup (void);
+// Records that qrcode holds the QR Code of the current text, ecl, mask and boostEcl.
+// Settings the encoder chose itself are recorded as such, so the same settings find it.
+void qr_cache_store (void);
+// Forgets the QR Code, to be called before qrcode gets overwritten
+void qr_cache_invalidate (void);
+// At power on, sets ecl, mask and boostEcl back to those of the cached QR Code, and
+// dataLen too if the text it was made from is still intact. Returns true in that case.
+bool qr_cache_restore (void);
+
+#endif // QR_CACHE_H_
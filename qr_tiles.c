@@ -0,0 +1,218 @@
+#include "qr_tiles.h"
+#include "screen.h"
+#include "vramq.h"
+#include "zp_overlay.h"
+#include <string.h>
+
+#define ROW_BYTES (qrcodegen_BUFFER_WIDTH / 8)
+#define MARKER_ID 0xff // tile ID reserved in QR_TILES_PATTERN_TABLE for the split marker
+#define MARKER_PALETTE 0x55 // attribute byte selecting bg palette 1 for a 32x32 block
+#define SPLIT_SPR_X 248
+#define SPLIT_SPR_CHR 0x7f // cursor glyph of the font, opaque in its top row
+
+static const uint8_t marker_tile[8] = { 0, 0, 0, 0, 0, 0, 0, 0xff };
+
+#pragma bss-name (push, "WRAM")
+
+uint8_t qr_tile_map[QR_TILES_MAX_SIDE * QR_TILES_MAX_SIDE];
+static uint8_t hash_slots[256]; // tile ID by hash of its pattern, 0 if the slot is free
+static uint8_t tile_pos[256]; // position of each tile ID, tile row in the high nibble
+
+#pragma bss-name (pop)
+
+uint8_t qr_tiles_side;
+
+// Kept in the zero page, laid over that of the encoder
+struct qr_tiles_scratch
+{
+  uint8_t size;
+  uint16_t pattern_table;
+  uint8_t next_id;
+  uint8_t tx;
+  uint8_t pos;
+  uint8_t id;
+  uint8_t hash;
+  uint8_t bits;
+  bool is_new;
+  bool update;
+  bool changed;
+  uint8_t old_pos;
+  uint8_t i;
+  uint8_t rows;
+  const uint8_t *src;
+  uint8_t *dest;
+  uint8_t *map;
+  uint8_t tile[8];
+  uint8_t other[8];
+};
+
+extern struct qr_tiles_scratch qr_tiles_zp;
+#pragma zpsym ("qr_tiles_zp")
+ZP_OVERLAY_CHECK(qr_tiles_scratch);
+#define d qr_tiles_zp
+
+static void fastcall _split (uint8_t ty);
+static void fastcall _read_tile (uint8_t pos);
+static uint8_t _find_tile (void);
+static bool _is_mask_free (void);
+
+void qr_tiles_init (void)
+{
+  vram_adr(QR_TILES_SPLIT_PATTERN_TABLE + (QR_TILES_SPLIT_FIRST_ID << 4));
+  vram_fill(0x00, QR_TILES_PATTERN_TABLE + 0x1000 - (QR_TILES_SPLIT_PATTERN_TABLE + (QR_TILES_SPLIT_FIRST_ID << 4)));
+}
+
+void fastcall qr_tiles_begin (bool update)
+{
+  d.update = update;
+  // The rows of an update are still on screen, those below the old split need it until
+  // _split moves it, or until they are all replaced
+  if (!update)
+  {
+    bank_bg_split(0xff);
+  }
+  d.size = qrcodegen_getSize();
+  qr_tiles_side = (d.size + 7) >> 3;
+  memset(hash_slots, 0, sizeof(hash_slots));
+  d.pattern_table = QR_TILES_PATTERN_TABLE;
+  d.next_id = 1;
+}
+
+void fastcall qr_tiles_row (uint8_t ty)
+{
+  if (d.pattern_table == QR_TILES_PATTERN_TABLE && d.next_id + qr_tiles_side > MARKER_ID)
+  {
+    _split(ty);
+  }
+
+  d.map = &qr_tile_map[ty * QR_TILES_MAX_SIDE];
+  d.changed = false;
+  for (d.tx = 0; d.tx < qr_tiles_side; ++d.tx)
+  {
+    d.pos = ty << 4 | d.tx;
+    d.dest = d.tile;
+    _read_tile(d.pos);
+    d.id = _find_tile();
+    // Only IDs below QR_TILES_SPLIT_FIRST_ID are never reused by the other pattern table
+    if (d.is_new && !(d.update && d.id < QR_TILES_SPLIT_FIRST_ID && d.old_pos == d.pos && _is_mask_free()))
+    {
+      vramq_put(d.pattern_table + (d.id << 4), d.tile, sizeof(d.tile));
+    }
+    if (d.map[d.tx] != d.id)
+    {
+      d.map[d.tx] = d.id;
+      d.changed = true;
+    }
+  }
+
+  if (!d.update || d.changed)
+  {
+    vramq_put(QR_TILES_NAMETABLE + (ty << 5), d.map, qr_tiles_side);
+  }
+
+  if (d.update && ty == qr_tiles_side - 1 && d.pattern_table == QR_TILES_PATTERN_TABLE)
+  {
+    // The new mask fits in one pattern table, the old split goes once every row is in
+    vramq_wait();
+    bank_bg_split(0xff);
+  }
+}
+
+// Moves tile row ty and the ones below it to QR_TILES_SPLIT_PATTERN_TABLE. The switch
+// happens at a sprite 0 hit on the last scanline above the row, against a marker tile
+// at the right edge of the screen. Both are white on white, so neither can be seen.
+static void fastcall _split (uint8_t ty)
+{
+  vramq_put(QR_TILES_PATTERN_TABLE + (MARKER_ID << 4), marker_tile, sizeof(marker_tile));
+  vramq_fill(NTADR_A(31, 0) + (ty << 5), MARKER_ID, 1);
+  vramq_fill(NAMETABLE_A + 0x3c7 + ((ty >> 2) << 3), MARKER_PALETTE, 1);
+  pal_col(0x05, 0x30);
+  pal_col(0x17, 0x30);
+  oam_spr(SPLIT_SPR_X, (ty << 3) + 6, SPLIT_SPR_CHR, OAM_BEHIND | 1, 0);
+  vramq_wait();
+  bank_bg_split(0);
+
+  memset(hash_slots, 0, sizeof(hash_slots));
+  d.pattern_table = QR_TILES_SPLIT_PATTERN_TABLE;
+  d.next_id = QR_TILES_SPLIT_FIRST_ID;
+}
+
+// Copies the tile at pos into d.dest. Rows past the bottom edge of the symbol are blank.
+// Modules past the right edge need no masking, as they are never drawn on.
+static void fastcall _read_tile (uint8_t pos)
+{
+  d.src = &qrcode[1 + ((uint16_t)(pos & 0xf0) << 3) + (pos & 0x0f)];
+  d.rows = d.size - ((pos & 0xf0) >> 1);
+  for (d.i = 0; d.i < 8; ++d.i, d.src += ROW_BYTES)
+  {
+    d.dest[d.i] = d.i < d.rows ? *d.src : 0x00;
+  }
+}
+
+// Returns the tile ID of the pattern in d.tile, giving it a new ID if it was never seen
+static uint8_t _find_tile (void)
+{
+  d.is_new = false;
+  d.hash = 0;
+  d.bits = 0;
+  for (d.i = 0; d.i < sizeof(d.tile); ++d.i)
+  {
+    d.hash = (d.hash << 1 | d.hash >> 7) ^ d.tile[d.i];
+    d.bits |= d.tile[d.i];
+  }
+  if (d.bits == 0)
+  {
+    return 0;
+  }
+
+  // Linear probing, there is always a free slot as there are fewer IDs than slots
+  for (; ; ++d.hash)
+  {
+    d.id = hash_slots[d.hash];
+    if (d.id == 0)
+    {
+      break;
+    }
+    d.dest = d.other;
+    _read_tile(tile_pos[d.id]);
+    if (memcmp(d.tile, d.other, sizeof(d.tile)) == 0)
+    {
+      return d.id;
+    }
+  }
+
+  if (d.next_id == 0)
+  {
+    return 0; // out of tile IDs
+  }
+  d.id = d.next_id++;
+  hash_slots[d.hash] = d.id;
+  d.old_pos = tile_pos[d.id];
+  tile_pos[d.id] = d.pos;
+  d.is_new = true;
+  return d.id;
+}
+
+// Tells whether the tile at d.pos only holds function modules other than the format
+// bits, according to the map the encoder left in tempBuffer. Its pattern is then the
+// same whatever the mask.
+static bool _is_mask_free (void)
+{
+  // The format bits are in module row and column 8, which is tile row and column 1
+  if ((d.pos & 0x0f) == 1 || (d.pos & 0xf0) == 0x10)
+  {
+    return false;
+  }
+
+  d.bits = (d.pos & 0x0f) == qr_tiles_side - 1 ? (uint8_t)(0xff << ((8 - (d.size & 7)) & 7)) : 0xff;
+  d.src = &tempBuffer[1 + ((uint16_t)(d.pos & 0xf0) << 3) + (d.pos & 0x0f)];
+  d.rows = d.size - ((d.pos & 0xf0) >> 1);
+  for (d.i = 0; d.i < 8 && d.i < d.rows; ++d.i, d.src += ROW_BYTES)
+  {
+    if (~*d.src & d.bits)
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,36 @@
+#if !defined(QR_TILES_H_)
+#define QR_TILES_H_
+
+#include "neslib.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define QR_TILES_PATTERN_TABLE 0x1000
+#define QR_TILES_SPLIT_PATTERN_TABLE 0x0000 // shared with the font, which uses IDs below QR_TILES_SPLIT_FIRST_ID
+#define QR_TILES_SPLIT_FIRST_ID 0x80
+#define QR_TILES_NAMETABLE NTADR_A(1, 1)
+#define QR_TILES_MAX_SIDE 16 // 125 modules, rounded up to whole tiles
+
+// Tiles per row and per column of the symbol, set by qr_tiles_begin
+extern uint8_t qr_tiles_side;
+// Tile ID of each position of the symbol, QR_TILES_MAX_SIDE IDs per row
+extern uint8_t qr_tile_map[];
+
+// Clears the parts of the pattern tables used for the symbol, with rendering off.
+// Only the low plane of a tile is ever uploaded after that, as the high plane stays clear.
+void qr_tiles_init (void);
+// Starts building the tiles of the symbol in qrcode. Tile ID 0 is the blank tile,
+// every other ID is given to one distinct 8x8 pattern. Once a tile row may not fit
+// in QR_TILES_PATTERN_TABLE anymore, that row and the ones below it are built in
+// QR_TILES_SPLIT_PATTERN_TABLE instead, which the background switches to mid-frame
+// with bank_bg_split. This needs sprite 0, and stays enabled until bank_bg_split(0xff).
+// Should even that run out of IDs, the extra patterns are shown blank.
+// With update set, the tiles of the same symbol are already on screen with another
+// mask, so patterns that do not depend on the mask and unchanged nametable rows are
+// not uploaded again, and the split of the old symbol stays until it is moved or,
+// after the last row, dropped.
+void fastcall qr_tiles_begin (bool update);
+// Builds tile row ty, queueing the upload of its new patterns and then its nametable row
+void fastcall qr_tiles_row (uint8_t ty);
+
+#endif // QR_TILES_H_
@@ -29,6 +29,8 @@
 #include <string.h>
 #include <stdbool.h>
 #include "qrcodegen.h"
+#include "build/capacity.h"
+#include "zp_overlay.h"
 
 #ifndef QRCODEGEN_TEST
 	#define testable static  // Keep functions private
@@ -36,6 +38,15 @@
 	#define testable  // Expose private functions
 #endif
 
+#ifdef QRCODEGEN_TIMING
+	#include "neslib.h"
+	#define PHASES_BEGIN() phasesBegin()
+	#define PHASE_END(phase) phaseEnd(phase)
+#else
+	#define PHASES_BEGIN()
+	#define PHASE_END(phase)
+#endif
+
 
 /*---- Forward declarations for private functions ----*/
 
@@ -56,45 +67,50 @@
 //   same writable buffer to concurrent calls to these functions.
 
 testable void fastcall appendBitsToQrcode(uint16_t val, uint8_t numBits);
+static void appendPayloadToQrcode();
 
 testable void addEccAndInterleave();
 testable int getNumDataCodewords(enum qrcodegen_Ecc ecl);
 testable int getNumRawDataModules();
 
-testable void reedSolomonComputeDivisor(int degree, uint8_t result[]);
+testable void reedSolomonComputeDivisor(uint8_t degree, uint8_t result[]);
 testable void reedSolomonComputeRemainder();
 extern uint8_t __fastcall__ reedSolomonMultiply(uint8_t x, uint8_t y);
+extern void __fastcall__ reedSolomonMultiplyAdd(uint8_t result[], const uint8_t x[], uint8_t len, uint8_t y);
 
 testable void initializeFunctionModules(uint8_t buf[]);
 static void drawLightFunctionModules();
 static void drawFormatBits(enum qrcodegen_Mask mask);
-testable int getAlignmentPatternPositions();
-static void fillRectangle(int left, int top, int width, int height, uint8_t buf[]);
+testable uint8_t getAlignmentPatternPositions();
+static void fillRectangle();
 
 static void drawCodewords();
 static void applyMask(enum qrcodegen_Mask mask);
 static uint16_t getPenaltyScore();
-static uint8_t finderPenaltyCountPatterns(const int runHistory[7]);
-static int finderPenaltyTerminateAndCount(bool currentRunColor, int currentRunLength, int runHistory[7], int qrsize);
-static void finderPenaltyAddHistory(int currentRunLength, int runHistory[7], int qrsize);
-
-testable bool getModuleBounded(const uint8_t buf[], int8_t x, int8_t y);
-testable void setModuleBounded(uint8_t buf[], int8_t x, int8_t y, bool isDark);
+static void finderPenaltyBegin();
+static uint8_t finderPenaltyCountPatterns();
+static uint8_t finderPenaltyTerminateAndCount();
+static void fastcall finderPenaltyAddHistory(uint8_t currentRunLength);
+static uint8_t fastcall finderPenaltyAddBorder(uint8_t runLength);
+
+testable bool getModuleBounded(const uint8_t buf[], uint8_t x, uint8_t y);
+testable void setModuleBounded(uint8_t buf[], uint8_t x, uint8_t y, bool isDark);
 testable void setModuleUnbounded(int8_t x, int8_t y, bool isDark);
-static bool fastcall getBit(int x, uint8_t i);
+static bool fastcall getBit(uint16_t x, uint8_t i);
 
-testable uint16_t getTotalBits();
 static uint8_t numCharCountBits();
 
+#ifdef QRCODEGEN_TIMING
+static void phasesBegin();
+static void phaseEnd(enum qrcodegen_Phase phase);
+#endif
+
 
 
 /*---- Private tables of constants ----*/
 
 #pragma rodata-name("BANK4")
 
-// Sentinel value for use in only some functions.
-#define LENGTH_OVERFLOW -1
-
 // For generating error correction codes.
 testable const int8_t ECC_CODEWORDS_PER_BLOCK[4][41] = {
 	// Version: (note that index 0 is for padding, and is set to an illegal value)
@@ -117,6 +133,23 @@ testable const int8_t NUM_ERROR_CORRECTION_BLOCKS[4][41] = {
 	{-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},  // High
 };
 
+// Bit of a module within its byte, the leftmost module is the most significant bit.
+static const uint8_t MODULE_MASKS[8] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+
+// For masking whole bytes of modules. Every mask pattern repeats after 24 modules
+// horizontally and 12 modules vertically, so the byte for row y and byte column b
+// is MASK_PATTERNS[mask][y % 12][b % 3].
+static const uint8_t MASK_PATTERNS[8][12][3] = {
+	{{0xAA, 0xAA, 0xAA}, {0x55, 0x55, 0x55}, {0xAA, 0xAA, 0xAA}, {0x55, 0x55, 0x55}, {0xAA, 0xAA, 0xAA}, {0x55, 0x55, 0x55}, {0xAA, 0xAA, 0xAA}, {0x55, 0x55, 0x55}, {0xAA, 0xAA, 0xAA}, {0x55, 0x55, 0x55}, {0xAA, 0xAA, 0xAA}, {0x55, 0x55, 0x55}},  // Mask 0
+	{{0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00}},  // Mask 1
+	{{0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}, {0x92, 0x49, 0x24}},  // Mask 2
+	{{0x92, 0x49, 0x24}, {0x24, 0x92, 0x49}, {0x49, 0x24, 0x92}, {0x92, 0x49, 0x24}, {0x24, 0x92, 0x49}, {0x49, 0x24, 0x92}, {0x92, 0x49, 0x24}, {0x24, 0x92, 0x49}, {0x49, 0x24, 0x92}, {0x92, 0x49, 0x24}, {0x24, 0x92, 0x49}, {0x49, 0x24, 0x92}},  // Mask 3
+	{{0xE3, 0x8E, 0x38}, {0xE3, 0x8E, 0x38}, {0x1C, 0x71, 0xC7}, {0x1C, 0x71, 0xC7}, {0xE3, 0x8E, 0x38}, {0xE3, 0x8E, 0x38}, {0x1C, 0x71, 0xC7}, {0x1C, 0x71, 0xC7}, {0xE3, 0x8E, 0x38}, {0xE3, 0x8E, 0x38}, {0x1C, 0x71, 0xC7}, {0x1C, 0x71, 0xC7}},  // Mask 4
+	{{0xFF, 0xFF, 0xFF}, {0x82, 0x08, 0x20}, {0x92, 0x49, 0x24}, {0xAA, 0xAA, 0xAA}, {0x92, 0x49, 0x24}, {0x82, 0x08, 0x20}, {0xFF, 0xFF, 0xFF}, {0x82, 0x08, 0x20}, {0x92, 0x49, 0x24}, {0xAA, 0xAA, 0xAA}, {0x92, 0x49, 0x24}, {0x82, 0x08, 0x20}},  // Mask 5
+	{{0xFF, 0xFF, 0xFF}, {0xE3, 0x8E, 0x38}, {0xDB, 0x6D, 0xB6}, {0xAA, 0xAA, 0xAA}, {0xB6, 0xDB, 0x6D}, {0x8E, 0x38, 0xE3}, {0xFF, 0xFF, 0xFF}, {0xE3, 0x8E, 0x38}, {0xDB, 0x6D, 0xB6}, {0xAA, 0xAA, 0xAA}, {0xB6, 0xDB, 0x6D}, {0x8E, 0x38, 0xE3}},  // Mask 6
+	{{0xAA, 0xAA, 0xAA}, {0x1C, 0x71, 0xC7}, {0x8E, 0x38, 0xE3}, {0x55, 0x55, 0x55}, {0xE3, 0x8E, 0x38}, {0x71, 0xC7, 0x1C}, {0xAA, 0xAA, 0xAA}, {0x1C, 0x71, 0xC7}, {0x8E, 0x38, 0xE3}, {0x55, 0x55, 0x55}, {0xE3, 0x8E, 0x38}, {0x71, 0xC7, 0x1C}},  // Mask 7
+};
+
 // For automatic mask pattern selection.
 static const int PENALTY_N1 =  3;
 static const int PENALTY_N2 =  3;
@@ -128,13 +161,26 @@ static const int PENALTY_N4 = 10;
 #pragma bss-name (push, "WRAM")
 
 #define MIN_VERSION qrcodegen_VERSION_MIN
-#define MAX_VERSION 27
+#define MAX_VERSION QR_CAPACITY_MAX_VERSION
 #define BUFFER_HEIGHT (MAX_VERSION * 4 + 17)
-#define BUFFER_WIDTH 256
+#define BUFFER_WIDTH qrcodegen_BUFFER_WIDTH
 #define BUFFER_SIZE ((BUFFER_WIDTH * BUFFER_HEIGHT) / 8 + 1)
+// NES-QR-DEMO: first written by an encode, so the text import blob can share its WRAM
+#pragma bss-name (push, "TEMPBUF")
 uint8_t tempBuffer[BUFFER_SIZE];
+#pragma bss-name (pop)
 uint8_t qrcode[BUFFER_SIZE];
 
+// NES-QR-DEMO: the text being edited, dataLen bytes long, which is what gets encoded
+uint8_t text[QR_CAPACITY_MAX_TEXT];
+
+#ifdef QRCODEGEN_REENCODE
+// NES-QR-DEMO: the data bit string of the text, header included, as packed by the last
+// encode since qrcodegen_encodeBinary() (see payloadCountBits)
+#define PAYLOAD_SIZE ((4 + 16 + QR_CAPACITY_MAX_TEXT * 8 + 7) / 8)
+static uint8_t payload[PAYLOAD_SIZE];
+#endif
+
 #pragma bss-name (pop)
 #pragma code-name ("BANK4")
 
@@ -148,66 +194,138 @@ static int bitLen;
 static uint8_t version;
 static uint8_t alignPatPos[7];
 
+#ifdef QRCODEGEN_REENCODE
+// NES-QR-DEMO: the count bits of the header in payload and its length in bits, the
+// count bits being 0 if it holds nothing, and the smallest version the text fits in
+// for each ECC level, 0 if not looked up yet. Not kept across power off like payload.
+static uint8_t payloadCountBits;
+static int payloadBits;
+static uint8_t payloadVersions[4];
+#endif
+
+#ifdef QRCODEGEN_TIMING
+uint16_t qrcodegen_phaseFrames[qrcodegen_Phase_COUNT];
+static uint16_t phaseStart;
+#endif
+
 extern uint8_t fastcall qr_reed_solomon_multiply(uint16_t adr);
 
-static struct {
+// NES-QR-DEMO: scratch variables of the functions below. Those of functions that run
+// while another one's are in use get their own fields, the others overlap. On the NES
+// they are kept in the zero page, laid over that of the tile upload (see zp_overlay.h).
+struct qrcodegen_Scratch {
 	union {
 		struct {
-			int16_t i;
+			int8_t i;
 			uint8_t *dest;
 			uint8_t byte;
 			uint8_t truncatedBitlen;
 			uint8_t shift;
 		} appendBitsToQrcode;
 		struct {
-			uint16_t index;
-		} getModuleBounded;
+			const uint8_t *src;
+			uint8_t *dest;
+			uint16_t i;
+			uint8_t byte;
+			uint8_t shift;
+		} appendPayloadToQrcode;
 		struct {
-			uint16_t index;
-			uint8_t bitIndex;
-			uint16_t byteIndex;
-		} setModuleBounded;
+			uint8_t qrsize;
+			uint8_t rowBytes;
+			uint8_t edge;
+			uint8_t *dat;
+			const uint8_t *fun;
+			uint8_t y;
+			uint8_t patY;
+			const uint8_t *pattern;
+			uint8_t b;
+			uint8_t patB;
+			uint8_t invert;
+		} applyMask;
 		struct {
 			uint8_t *dat;
-			int datLen;
+			uint8_t datLen;
 			uint8_t rsdiv[qrcodegen_REED_SOLOMON_DEGREE_MAX];
 			uint8_t blockEccLen;
 			uint8_t *ecc;
-			int shortBlockDataLen;
+			uint8_t shortBlockDataLen;
 		} addEccAndInterleave;
 	};
 	union
 	{
 		struct
 		{
-			int i;
-			uint8_t j;
+			uint8_t i;
 			uint8_t factor;
 		} reedSolomonComputeRemainder;
+		struct {
+			uint8_t *buf;
+			uint8_t left;
+			uint8_t top;
+			uint8_t width;
+			uint8_t height;
+			uint8_t dx;
+			uint8_t dy;
+		} fillRectangle;
+		struct {
+			uint16_t datLen;
+			uint8_t qrsize;
+			uint16_t i;
+			uint8_t right;
+			uint8_t vert;
+			uint8_t j;
+			uint8_t x;
+			bool upward;
+			uint8_t y;
+			bool dark;
+		} drawCodewords;
+		struct {
+			uint8_t qrsize;
+			const uint8_t *row;
+			uint8_t bit;
+			uint8_t x;
+			uint8_t y;
+			bool color;
+			bool runColor;
+			uint8_t run;
+			uint8_t runHistory[7];
+			uint16_t dark;
+			uint16_t result;
+		} getPenaltyScore;
 	};
-	struct {
-		uint16_t datLen;
-		uint8_t qrsize;
-		uint16_t i;
-		uint8_t right;
-		uint8_t vert;
-		uint8_t j;
-		uint8_t x;
-		bool upward;
-		uint8_t y;
-		bool dark;
-	} drawCodewords;
-} d;
+};
+
+#ifdef __CC65__
+extern struct qrcodegen_Scratch qrcodegen_zp;
+#pragma zpsym ("qrcodegen_zp")
+ZP_OVERLAY_CHECK(qrcodegen_Scratch);
+#define d qrcodegen_zp
+#else
+static struct qrcodegen_Scratch d;
+#endif
 
 /*---- High-level QR Code encoding functions ----*/
 
 // Public function - see documentation comment in header file.
 bool qrcodegen_encodeBinary() {
 	bitLength = dataLen * 8;
+#ifdef QRCODEGEN_REENCODE
+	payloadCountBits = 0;
+	memset(payloadVersions, 0, sizeof(payloadVersions));
+#endif
 	return qrcodegen_encodeSegmentsAdvanced();
 }
 
 
+#ifdef QRCODEGEN_REENCODE
+// Public function - see documentation comment in header file.
+bool qrcodegen_reencode() {
+	bitLength = dataLen * 8;  // Not set yet if the code shown was kept from before power off
+	return qrcodegen_encodeSegmentsAdvanced();
+}
+#endif
+
+
 // Appends the given number of low-order bits of the given value to the given byte-based
 // bit buffer, increasing the bit length. Requires 0 <= numBits <= 16 and val < 2^numBits.
 testable void fastcall appendBitsToQrcode(uint16_t val, uint8_t numBits) {
@@ -222,42 +340,69 @@ testable void fastcall appendBitsToQrcode(uint16_t val, uint8_t numBits) {
 
 
 
+// NES-QR-DEMO: appends the bytes of the text a whole byte at a time. Like appendBitsToQrcode(),
+// this relies on qrcode being cleared beforehand.
+static void appendPayloadToQrcode() {
+	d.appendPayloadToQrcode.src = text;
+	d.appendPayloadToQrcode.dest = &qrcode[bitLen >> 3];
+	d.appendPayloadToQrcode.shift = bitLen & 7;
+	for (d.appendPayloadToQrcode.i = dataLen; d.appendPayloadToQrcode.i != 0; --d.appendPayloadToQrcode.i) {
+		d.appendPayloadToQrcode.byte = *d.appendPayloadToQrcode.src++;
+		*d.appendPayloadToQrcode.dest++ |= d.appendPayloadToQrcode.byte >> d.appendPayloadToQrcode.shift;
+		*d.appendPayloadToQrcode.dest = d.appendPayloadToQrcode.byte << (8 - d.appendPayloadToQrcode.shift);
+	}
+	bitLen += bitLength;
+}
+
+
+
 /*---- Low-level QR Code encoding functions ----*/
 
 // Public function - see documentation comment in header file.
 bool qrcodegen_encodeSegmentsAdvanced() {
-	// Find the minimal version number to use
-	uint16_t dataUsedBits;
 	int i, dataCapacityBits, terminatorBits;
 	uint8_t padByte;
-	for (version = MIN_VERSION; ; version++) {
-		uint16_t dataCapacityBits = getNumDataCodewords(ecl) * 8;  // Number of data bits available
-		dataUsedBits = getTotalBits();
-		if (dataUsedBits != LENGTH_OVERFLOW && dataUsedBits <= dataCapacityBits)
-			break;  // This version number is found to be suitable
-		if (version >= MAX_VERSION) {  // All versions in the range could not fit the given data
-			qrcode[0] = 0;  // Set size to invalid value for safety
-			return false;
-		}
+	
+	// Find the minimal version number to use
+	PHASES_BEGIN();
+#ifdef QRCODEGEN_REENCODE
+	version = payloadVersions[ecl];
+	if (version == 0)
+		version = payloadVersions[ecl] = qrcodegen_getMinVersion(dataLen);
+#else
+	version = qrcodegen_getMinVersion(dataLen);
+#endif
+	if (version == 0) {  // All versions in the range could not fit the given data
+		qrcode[0] = 0;  // Set size to invalid value for safety
+		return false;
 	}
 	
 	// Increase the error correction level while the data still fits in the current version number
 	for (i = (int)qrcodegen_Ecc_MEDIUM; i <= (int)qrcodegen_Ecc_HIGH; i++) {  // From low to high
-		if (boostEcl && dataUsedBits <= getNumDataCodewords((enum qrcodegen_Ecc)i) * 8)
+		if (boostEcl && dataLen <= qr_capacity[i][version])
 			ecl = (enum qrcodegen_Ecc)i;
 	}
+	PHASE_END(qrcodegen_Phase_VERSION);
 	
 	// Concatenate all segments to create the data bit string
 	memset(qrcode, 0, BUFFER_SIZE * sizeof(qrcode[0]));
-	bitLen = 0;
+#ifdef QRCODEGEN_REENCODE
+	// NES-QR-DEMO: the bit string packed last time serves again if the header is as wide
+	if (payloadCountBits == numCharCountBits()) {
+		bitLen = payloadBits;
+		memcpy(qrcode, payload, (bitLen + 7) >> 3);
+	} else
+#endif
 	{
-		int j;
+		bitLen = 0;
 		appendBitsToQrcode((unsigned int)qrcodegen_Mode_BYTE, 4);
 		appendBitsToQrcode((unsigned int)dataLen, numCharCountBits());
-		for (j = 0; j < bitLength; j++) {
-			int bit = (tempBuffer[j >> 3] >> (7 - (j & 7))) & 1;
-			appendBitsToQrcode((unsigned int)bit, 1);
-		}
+		appendPayloadToQrcode();
+#ifdef QRCODEGEN_REENCODE
+		payloadCountBits = numCharCountBits();
+		payloadBits = bitLen;
+		memcpy(payload, qrcode, (bitLen + 7) >> 3);
+#endif
 	}
 	
 	// Add terminator and pad up to a byte if applicable
@@ -271,14 +416,19 @@ bool qrcodegen_encodeSegmentsAdvanced() {
 	// Pad with alternating bytes until data capacity is reached
 	for (padByte = 0xEC; bitLen < dataCapacityBits; padByte ^= 0xEC ^ 0x11)
 		appendBitsToQrcode(padByte, 8);
+	PHASE_END(qrcodegen_Phase_BITS);
 	
 	// Compute ECC, draw modules
 	addEccAndInterleave();
+	PHASE_END(qrcodegen_Phase_ECC);
 	initializeFunctionModules(qrcode);
+	PHASE_END(qrcodegen_Phase_FUNCTION);
 	d.drawCodewords.datLen = getNumRawDataModules() / 8;
 	drawCodewords();
+	PHASE_END(qrcodegen_Phase_CODEWORDS);
 	drawLightFunctionModules();
 	initializeFunctionModules(tempBuffer);
+	PHASE_END(qrcodegen_Phase_FUNCTION);
 	
 	// Do masking
 	if (mask == qrcodegen_Mask_AUTO) {  // Automatically choose best mask
@@ -294,15 +444,27 @@ bool qrcodegen_encodeSegmentsAdvanced() {
 				minPenalty = penalty;
 			}
 			applyMask(msk);  // Undoes the mask due to XOR
+			PHASE_END((enum qrcodegen_Phase)(qrcodegen_Phase_MASK_0 + i));
 		}
 	}
 	applyMask(mask);  // Apply the final choice of mask
 	drawFormatBits(mask);  // Overwrite old format bits
+	PHASE_END(qrcodegen_Phase_FORMAT);
 	return true;
 }
 
 
 
+// Public function - see documentation comment in header file.
+void qrcodegen_setMask(enum qrcodegen_Mask msk) {
+	applyMask(mask);  // Undoes the current mask due to XOR
+	applyMask(msk);
+	drawFormatBits(msk);
+	mask = msk;
+}
+
+
+
 /*---- Error correction code generation functions ----*/
 
 // Appends error correction bytes to each block of the given data array, then interleaves
@@ -314,8 +476,8 @@ testable void addEccAndInterleave() {
 	uint8_t numBlocks = NUM_ERROR_CORRECTION_BLOCKS[ecl][version];
 	int rawCodewords = getNumRawDataModules() / 8;
 	int dataLen = getNumDataCodewords(ecl);
-	int numShortBlocks = numBlocks - rawCodewords % numBlocks;
-	int i;
+	uint8_t numShortBlocks = numBlocks - rawCodewords % numBlocks;
+	uint8_t i;
 	d.addEccAndInterleave.blockEccLen = ECC_CODEWORDS_PER_BLOCK  [ecl][version];
 	d.addEccAndInterleave.shortBlockDataLen = rawCodewords / numBlocks - d.addEccAndInterleave.blockEccLen;
 	
@@ -324,7 +486,8 @@ testable void addEccAndInterleave() {
 	reedSolomonComputeDivisor(d.addEccAndInterleave.blockEccLen, d.addEccAndInterleave.rsdiv);
 	d.addEccAndInterleave.dat = qrcode;
 	for (i = 0; i < numBlocks; i++) {
-		int j, k;
+		uint8_t j;
+		uint16_t k;
 		d.addEccAndInterleave.datLen = d.addEccAndInterleave.shortBlockDataLen + (i < numShortBlocks ? 0 : 1);
 		d.addEccAndInterleave.ecc = &qrcode[dataLen];  // Temporary storage
 		reedSolomonComputeRemainder();
@@ -369,9 +532,9 @@ testable int getNumRawDataModules() {
 
 // Computes a Reed-Solomon ECC generator polynomial for the given degree, storing in result[0 : degree].
 // This could be implemented as a lookup table over all possible parameter values, instead of as an algorithm.
-testable void reedSolomonComputeDivisor(int degree, uint8_t result[]) {
+testable void reedSolomonComputeDivisor(uint8_t degree, uint8_t result[]) {
 	uint8_t root;
-	int i, j;
+	uint8_t i, j;
 	// Polynomial coefficients are stored from highest to lowest power, excluding the leading term which is always 1.
 	// For example the polynomial x^3 + 255x^2 + 8x + 93 is stored as the uint8 array {255, 8, 93}.
 	memset(result, 0, (size_t)degree * sizeof(result[0]));
@@ -403,8 +566,8 @@ testable void reedSolomonComputeRemainder(/*const uint8_t data[], int dataLen,
 		d.reedSolomonComputeRemainder.factor = d.addEccAndInterleave.dat[d.reedSolomonComputeRemainder.i] ^ d.addEccAndInterleave.ecc[0];
 		memmove(&d.addEccAndInterleave.ecc[0], &d.addEccAndInterleave.ecc[1], (size_t)(d.addEccAndInterleave.blockEccLen - 1) * sizeof(d.addEccAndInterleave.ecc[0]));
 		d.addEccAndInterleave.ecc[d.addEccAndInterleave.blockEccLen - 1] = 0;
-		for (d.reedSolomonComputeRemainder.j = 0; d.reedSolomonComputeRemainder.j < d.addEccAndInterleave.blockEccLen; ++d.reedSolomonComputeRemainder.j)
-			d.addEccAndInterleave.ecc[d.reedSolomonComputeRemainder.j] ^= reedSolomonMultiply(d.addEccAndInterleave.rsdiv[d.reedSolomonComputeRemainder.j], d.reedSolomonComputeRemainder.factor);
+		// NES-QR-DEMO: every product by factor is looked up with its bank mapped only once
+		reedSolomonMultiplyAdd(d.addEccAndInterleave.ecc, d.addEccAndInterleave.rsdiv, d.addEccAndInterleave.blockEccLen, d.reedSolomonComputeRemainder.factor);
 	}
 }
 
@@ -420,36 +583,51 @@ testable void reedSolomonComputeRemainder(/*const uint8_t data[], int dataLen,
 // version's size, then marks every function module as dark.
 testable void initializeFunctionModules(uint8_t buf[]) {
 	// Initialize QR Code
-	int qrsize = version * 4 + 17;
+	uint8_t qrsize = version * 4 + 17;
 	memset(buf, 0, BUFFER_SIZE);
-	buf[0] = (uint8_t)qrsize;
+	buf[0] = qrsize;
+	
+	// NES-QR-DEMO: fillRectangle() takes its rectangle in d.fillRectangle
+	d.fillRectangle.buf = buf;
 	
 	// Fill horizontal and vertical timing patterns
-	fillRectangle(6, 0, 1, qrsize, buf);
-	fillRectangle(0, 6, qrsize, 1, buf);
+	d.fillRectangle.left = 6; d.fillRectangle.top = 0; d.fillRectangle.width = 1; d.fillRectangle.height = qrsize;
+	fillRectangle();
+	d.fillRectangle.left = 0; d.fillRectangle.top = 6; d.fillRectangle.width = qrsize; d.fillRectangle.height = 1;
+	fillRectangle();
 	
 	// Fill 3 finder patterns (all corners except bottom right) and format bits
-	fillRectangle(0, 0, 9, 9, buf);
-	fillRectangle(qrsize - 8, 0, 8, 9, buf);
-	fillRectangle(0, qrsize - 8, 9, 8, buf);
+	d.fillRectangle.left = 0; d.fillRectangle.top = 0; d.fillRectangle.width = 9; d.fillRectangle.height = 9;
+	fillRectangle();
+	d.fillRectangle.left = qrsize - 8; d.fillRectangle.top = 0; d.fillRectangle.width = 8; d.fillRectangle.height = 9;
+	fillRectangle();
+	d.fillRectangle.left = 0; d.fillRectangle.top = qrsize - 8; d.fillRectangle.width = 9; d.fillRectangle.height = 8;
+	fillRectangle();
 	
 	// Fill numerous alignment patterns
 	{
-		int numAlign, i, j;
+		uint8_t numAlign, i, j;
 		numAlign = getAlignmentPatternPositions();
+		d.fillRectangle.width = 5;
+		d.fillRectangle.height = 5;
 		for (i = 0; i < numAlign; i++) {
 			for (j = 0; j < numAlign; j++) {
 				// Don't draw on the three finder corners
-				if (!((i == 0 && j == 0) || (i == 0 && j == numAlign - 1) || (i == numAlign - 1 && j == 0)))
-					fillRectangle(alignPatPos[i] - 2, alignPatPos[j] - 2, 5, 5, buf);
+				if (!((i == 0 && j == 0) || (i == 0 && j == numAlign - 1) || (i == numAlign - 1 && j == 0))) {
+					d.fillRectangle.left = alignPatPos[i] - 2;
+					d.fillRectangle.top = alignPatPos[j] - 2;
+					fillRectangle();
+				}
 			}
 		}
 	}
 	
 	// Fill version blocks
 	if (version >= 7) {
-		fillRectangle(qrsize - 11, 0, 3, 6, buf);
-		fillRectangle(0, qrsize - 11, 6, 3, buf);
+		d.fillRectangle.left = qrsize - 11; d.fillRectangle.top = 0; d.fillRectangle.width = 3; d.fillRectangle.height = 6;
+		fillRectangle();
+		d.fillRectangle.left = 0; d.fillRectangle.top = qrsize - 11; d.fillRectangle.width = 6; d.fillRectangle.height = 3;
+		fillRectangle();
 	}
 }
 
@@ -458,9 +636,10 @@ testable void initializeFunctionModules(uint8_t buf[]) {
 // non-function modules. This does not draw the format bits. This requires all function modules to be previously
 // marked dark (namely by initializeFunctionModules()), because this may skip redrawing dark function modules.
 static void drawLightFunctionModules() {
-	int i, j, dy, dx;
+	uint8_t i, j;
+	int8_t dy, dx;
 	// Draw horizontal and vertical timing patterns
-	int qrsize = qrcodegen_getSize();
+	uint8_t qrsize = qrcodegen_getSize();
 	for (i = 7; i < qrsize - 7; i += 2) {
 		setModuleBounded(qrcode, 6, i, false);
 		setModuleBounded(qrcode, i, 6, false);
@@ -469,9 +648,9 @@ static void drawLightFunctionModules() {
 	// Draw 3 finder patterns (all corners except bottom right; overwrites some timing modules)
 	for (dy = -4; dy <= 4; dy++) {
 		for (dx = -4; dx <= 4; dx++) {
-			int dist = abs(dx);
-			if (abs(dy) > dist)
-				dist = abs(dy);
+			uint8_t dist = dx < 0 ? -dx : dx;
+			if ((dy < 0 ? -dy : dy) > dist)
+				dist = dy < 0 ? -dy : dy;
 			if (dist == 2 || dist == 4) {
 				setModuleUnbounded(3 + dx, 3 + dy, false);
 				setModuleUnbounded(qrsize - 4 + dx, 3 + dy, false);
@@ -482,7 +661,7 @@ static void drawLightFunctionModules() {
 	
 	// Draw numerous alignment patterns
 	{
-		int numAlign = getAlignmentPatternPositions();
+		uint8_t numAlign = getAlignmentPatternPositions();
 		for (i = 0; i < numAlign; i++) {
 			for (j = 0; j < numAlign; j++) {
 				if ((i == 0 && j == 0) || (i == 0 && j == numAlign - 1) || (i == numAlign - 1 && j == 0))
@@ -497,17 +676,17 @@ static void drawLightFunctionModules() {
 	
 	// Draw version blocks
 	if (version >= 7) {
-		uint16_t bits;
+		uint32_t bits;
 		// Calculate error correction code and pack bits
-		int rem = version;  // version is uint6, in the range [7, 40]
+		uint16_t rem = version;  // version is uint6, in the range [7, 40]
 		for (i = 0; i < 12; i++)
 			rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
-		bits = (uint16_t)version << 12 | rem;  // uint18
+		bits = (uint32_t)version << 12 | rem;  // uint18
 		
 		// Draw two copies
 		for (i = 0; i < 6; i++) {
 			for (j = 0; j < 3; j++) {
-				int k = qrsize - 11 + j;
+				uint8_t k = qrsize - 11 + j;
 				setModuleBounded(qrcode, k, i, (bits & 1) != 0);
 				setModuleBounded(qrcode, i, k, (bits & 1) != 0);
 				bits >>= 1;
@@ -522,13 +701,14 @@ static void drawLightFunctionModules() {
 // the format bits, unlike drawLightFunctionModules() which might skip dark modules.
 static void drawFormatBits(enum qrcodegen_Mask mask) {
 	// Calculate error correction code and pack bits
-	static const int table[] = {1, 0, 3, 2};
-	int data = table[(int)ecl] << 3 | (int)mask;  // errCorrLvl is uint2, mask is uint3
-	int rem = data;
-	int i, bits, qrsize;
+	static const uint8_t table[] = {1, 0, 3, 2};
+	uint8_t data = table[(int)ecl] << 3 | (int)mask;  // errCorrLvl is uint2, mask is uint3
+	uint16_t rem = data;
+	uint16_t bits;
+	uint8_t i, qrsize;
 	for (i = 0; i < 10; i++)
 		rem = (rem << 1) ^ ((rem >> 9) * 0x537);
-	bits = (data << 10 | rem) ^ 0x5412;  // uint15
+	bits = ((uint16_t)data << 10 | rem) ^ 0x5412;  // uint15
 	
 	// Draw first copy
 	for (i = 0; i <= 5; i++)
@@ -553,16 +733,16 @@ static void drawFormatBits(enum qrcodegen_Mask mask) {
 // for this version number, returning the length of the list (in the range [0,7]).
 // Each position is in the range [0,177), and are used on both the x and y axes.
 // This could be implemented as lookup table of 40 variable-length lists of unsigned bytes.
-testable int getAlignmentPatternPositions() {
+testable uint8_t getAlignmentPatternPositions() {
 	if (version == 1)
 		return 0;
 	{
-		int numAlign = version / 7 + 2;
-		int step = (version == 32) ? 26 :
+		uint8_t numAlign = version / 7 + 2;
+		uint8_t step = (version == 32) ? 26 :
 			(version * 4 + numAlign * 2 + 1) / (numAlign * 2 - 2) * 2;
-		int i, pos;
+		uint8_t i, pos;
 		for (i = numAlign - 1, pos = version * 4 + 10; i >= 1; i--, pos -= step)
-			alignPatPos[i] = (uint8_t)pos;
+			alignPatPos[i] = pos;
 		alignPatPos[0] = 6;
 		return numAlign;
 	}
@@ -570,11 +750,11 @@ testable int getAlignmentPatternPositions() {
 
 
 // Sets every module in the range [left : left + width] * [top : top + height] to dark.
-static void fillRectangle(int left, int top, int width, int height, uint8_t buf[]) {
-	int dy, dx;
-	for (dy = 0; dy < height; dy++) {
-		for (dx = 0; dx < width; dx++)
-			setModuleBounded(buf, left + dx, top + dy, true);
+// NES-QR-DEMO: the rectangle and buffer are given in d.fillRectangle.
+static void fillRectangle() {
+	for (d.fillRectangle.dy = 0; d.fillRectangle.dy < d.fillRectangle.height; d.fillRectangle.dy++) {
+		for (d.fillRectangle.dx = 0; d.fillRectangle.dx < d.fillRectangle.width; d.fillRectangle.dx++)
+			setModuleBounded(d.fillRectangle.buf, d.fillRectangle.left + d.fillRectangle.dx, d.fillRectangle.top + d.fillRectangle.dy, true);
 	}
 }
 
@@ -615,26 +795,28 @@ static void drawCodewords() {
 // the same mask value a second time will undo the mask. A final well-formed
 // QR Code needs exactly one (not zero, two, etc.) mask applied.
 static void applyMask(enum qrcodegen_Mask mask) {
-	int qrsize = qrcodegen_getSize();
-	int y, x;
-	bool invert, val;
-	for (y = 0; y < qrsize; y++) {
-		for (x = 0; x < qrsize; x++) {
-			if (getModuleBounded(tempBuffer, x, y))
-				continue;
-			switch ((int)mask) {
-				case 0:  invert = (x + y) % 2 == 0;                    break;
-				case 1:  invert = y % 2 == 0;                          break;
-				case 2:  invert = x % 3 == 0;                          break;
-				case 3:  invert = (x + y) % 3 == 0;                    break;
-				case 4:  invert = (x / 3 + y / 2) % 2 == 0;            break;
-				case 5:  invert = x * y % 2 + x * y % 3 == 0;          break;
-				case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
-				case 7:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
-			}
-			val = getModuleBounded(qrcode, x, y);
-			setModuleBounded(qrcode, x, y, val ^ invert);
+	// NES-QR-DEMO: works on 8 modules at a time, tempBuffer must still hold the function modules
+	d.applyMask.qrsize = qrcodegen_getSize();
+	d.applyMask.rowBytes = (d.applyMask.qrsize + 7) >> 3;
+	d.applyMask.edge = (uint8_t)(0xFF << ((8 - (d.applyMask.qrsize & 7)) & 7));
+	d.applyMask.dat = &qrcode[1];
+	d.applyMask.fun = &tempBuffer[1];
+	d.applyMask.patY = 0;
+	for (d.applyMask.y = 0; d.applyMask.y < d.applyMask.qrsize; d.applyMask.y++) {
+		d.applyMask.pattern = MASK_PATTERNS[mask][d.applyMask.patY];
+		d.applyMask.patB = 0;
+		for (d.applyMask.b = 0; d.applyMask.b < d.applyMask.rowBytes; d.applyMask.b++) {
+			d.applyMask.invert = d.applyMask.pattern[d.applyMask.patB] & ~d.applyMask.fun[d.applyMask.b];
+			if (d.applyMask.b + 1 == d.applyMask.rowBytes)
+				d.applyMask.invert &= d.applyMask.edge;  // Leave the modules past the right edge light
+			d.applyMask.dat[d.applyMask.b] ^= d.applyMask.invert;
+			if (++d.applyMask.patB == 3)
+				d.applyMask.patB = 0;
 		}
+		d.applyMask.dat += BUFFER_WIDTH / 8;
+		d.applyMask.fun += BUFFER_WIDTH / 8;
+		if (++d.applyMask.patY == 12)
+			d.applyMask.patY = 0;
 	}
 }
 
@@ -642,120 +824,168 @@ static void applyMask(enum qrcodegen_Mask mask) {
 // Calculates and returns the penalty score based on state of the given QR Code's current modules.
 // This is used by the automatic mask choice algorithm to find the mask pattern that yields the lowest score.
 static uint16_t getPenaltyScore() {
-	int qrsize = qrcodegen_getSize();
-	uint16_t result = 0;
+	// NES-QR-DEMO: each module is read once per pass straight from its row of qrcode, and
+	// the runs are counted in d.getPenaltyScore by the helpers below
+	d.getPenaltyScore.qrsize = qrcodegen_getSize();
+	d.getPenaltyScore.result = 0;
 	
 	// Adjacent modules in row having same color, and finder-like patterns
-	int y, x, dark;
-	for (y = 0; y < qrsize; y++) {
-		bool runColor = false;
-		int runX = 0;
-		int runHistory[7] = {0};
-		for (x = 0; x < qrsize; x++) {
-			if (getModuleBounded(qrcode, x, y) == runColor) {
-				runX++;
-				if (runX == 5)
-					result += PENALTY_N1;
-				else if (runX > 5)
-					result++;
+	d.getPenaltyScore.row = &qrcode[1];
+	for (d.getPenaltyScore.y = 0; d.getPenaltyScore.y < d.getPenaltyScore.qrsize; d.getPenaltyScore.y++) {
+		finderPenaltyBegin();
+		for (d.getPenaltyScore.x = 0; d.getPenaltyScore.x < d.getPenaltyScore.qrsize; d.getPenaltyScore.x++) {
+			d.getPenaltyScore.color = (d.getPenaltyScore.row[d.getPenaltyScore.x >> 3] & MODULE_MASKS[d.getPenaltyScore.x & 7]) != 0;
+			if (d.getPenaltyScore.color == d.getPenaltyScore.runColor) {
+				d.getPenaltyScore.run++;
+				if (d.getPenaltyScore.run == 5)
+					d.getPenaltyScore.result += PENALTY_N1;
+				else if (d.getPenaltyScore.run > 5)
+					d.getPenaltyScore.result++;
 			} else {
-				finderPenaltyAddHistory(runX, runHistory, qrsize);
-				if (!runColor)
-					result += finderPenaltyCountPatterns(runHistory) * PENALTY_N3;
-				runColor = getModuleBounded(qrcode, x, y);
-				runX = 1;
+				finderPenaltyAddHistory(d.getPenaltyScore.run);
+				if (!d.getPenaltyScore.runColor)
+					d.getPenaltyScore.result += finderPenaltyCountPatterns() * PENALTY_N3;
+				d.getPenaltyScore.runColor = d.getPenaltyScore.color;
+				d.getPenaltyScore.run = 1;
 			}
 		}
-		result += finderPenaltyTerminateAndCount(runColor, runX, runHistory, qrsize) * PENALTY_N3;
+		d.getPenaltyScore.result += finderPenaltyTerminateAndCount() * PENALTY_N3;
+		d.getPenaltyScore.row += BUFFER_WIDTH / 8;
 	}
 	// Adjacent modules in column having same color, and finder-like patterns
-	for (x = 0; x < qrsize; x++) {
-		bool runColor = false;
-		int runY = 0;
-		int runHistory[7] = {0};
-		for (y = 0; y < qrsize; y++) {
-			if (getModuleBounded(qrcode, x, y) == runColor) {
-				runY++;
-				if (runY == 5)
-					result += PENALTY_N1;
-				else if (runY > 5)
-					result++;
+	for (d.getPenaltyScore.x = 0; d.getPenaltyScore.x < d.getPenaltyScore.qrsize; d.getPenaltyScore.x++) {
+		finderPenaltyBegin();
+		d.getPenaltyScore.row = &qrcode[1 + (d.getPenaltyScore.x >> 3)];
+		d.getPenaltyScore.bit = MODULE_MASKS[d.getPenaltyScore.x & 7];
+		for (d.getPenaltyScore.y = 0; d.getPenaltyScore.y < d.getPenaltyScore.qrsize; d.getPenaltyScore.y++) {
+			d.getPenaltyScore.color = (*d.getPenaltyScore.row & d.getPenaltyScore.bit) != 0;
+			if (d.getPenaltyScore.color == d.getPenaltyScore.runColor) {
+				d.getPenaltyScore.run++;
+				if (d.getPenaltyScore.run == 5)
+					d.getPenaltyScore.result += PENALTY_N1;
+				else if (d.getPenaltyScore.run > 5)
+					d.getPenaltyScore.result++;
 			} else {
-				finderPenaltyAddHistory(runY, runHistory, qrsize);
-				if (!runColor)
-					result += finderPenaltyCountPatterns(runHistory) * PENALTY_N3;
-				runColor = getModuleBounded(qrcode, x, y);
-				runY = 1;
+				finderPenaltyAddHistory(d.getPenaltyScore.run);
+				if (!d.getPenaltyScore.runColor)
+					d.getPenaltyScore.result += finderPenaltyCountPatterns() * PENALTY_N3;
+				d.getPenaltyScore.runColor = d.getPenaltyScore.color;
+				d.getPenaltyScore.run = 1;
 			}
+			d.getPenaltyScore.row += BUFFER_WIDTH / 8;
 		}
-		result += finderPenaltyTerminateAndCount(runColor, runY, runHistory, qrsize) * PENALTY_N3;
+		d.getPenaltyScore.result += finderPenaltyTerminateAndCount() * PENALTY_N3;
 	}
 	
-	// 2*2 blocks of modules having same color
-	for (y = 0; y < qrsize - 1; y++) {
-		for (x = 0; x < qrsize - 1; x++) {
-			bool  color = getModuleBounded(qrcode, x, y);
-			if (  color == getModuleBounded(qrcode, x + 1, y) &&
-			      color == getModuleBounded(qrcode, x, y + 1) &&
-			      color == getModuleBounded(qrcode, x + 1, y + 1))
-				result += PENALTY_N2;
+	// 2*2 blocks of modules having same color, comparing each row with the next one
+	d.getPenaltyScore.row = &qrcode[1];
+	for (d.getPenaltyScore.y = 0; d.getPenaltyScore.y < d.getPenaltyScore.qrsize - 1; d.getPenaltyScore.y++) {
+		d.getPenaltyScore.color = (d.getPenaltyScore.row[0] & MODULE_MASKS[0]) != 0;
+		d.getPenaltyScore.runColor = (d.getPenaltyScore.row[BUFFER_WIDTH / 8] & MODULE_MASKS[0]) != 0;
+		for (d.getPenaltyScore.x = 1; d.getPenaltyScore.x < d.getPenaltyScore.qrsize; d.getPenaltyScore.x++) {
+			// color and runColor are the modules left of x in this row and the next one
+			d.getPenaltyScore.bit = MODULE_MASKS[d.getPenaltyScore.x & 7];
+			if (d.getPenaltyScore.color == d.getPenaltyScore.runColor) {
+				if (d.getPenaltyScore.color == ((d.getPenaltyScore.row[d.getPenaltyScore.x >> 3] & d.getPenaltyScore.bit) != 0) &&
+				    d.getPenaltyScore.color == ((d.getPenaltyScore.row[(d.getPenaltyScore.x >> 3) + BUFFER_WIDTH / 8] & d.getPenaltyScore.bit) != 0))
+					d.getPenaltyScore.result += PENALTY_N2;
+			}
+			d.getPenaltyScore.color = (d.getPenaltyScore.row[d.getPenaltyScore.x >> 3] & d.getPenaltyScore.bit) != 0;
+			d.getPenaltyScore.runColor = (d.getPenaltyScore.row[(d.getPenaltyScore.x >> 3) + BUFFER_WIDTH / 8] & d.getPenaltyScore.bit) != 0;
 		}
+		d.getPenaltyScore.row += BUFFER_WIDTH / 8;
 	}
 	
 	// Balance of dark and light modules
-	dark = 0;
-	for (y = 0; y < qrsize; y++) {
-		for (x = 0; x < qrsize; x++) {
-			if (getModuleBounded(qrcode, x, y))
-				dark++;
+	d.getPenaltyScore.dark = 0;
+	d.getPenaltyScore.row = &qrcode[1];
+	for (d.getPenaltyScore.y = 0; d.getPenaltyScore.y < d.getPenaltyScore.qrsize; d.getPenaltyScore.y++) {
+		for (d.getPenaltyScore.x = 0; d.getPenaltyScore.x < d.getPenaltyScore.qrsize; d.getPenaltyScore.x++) {
+			if (d.getPenaltyScore.row[d.getPenaltyScore.x >> 3] & MODULE_MASKS[d.getPenaltyScore.x & 7])
+				d.getPenaltyScore.dark++;
 		}
+		d.getPenaltyScore.row += BUFFER_WIDTH / 8;
 	}
 	{
-		int total = qrsize * qrsize;  // Note that size is odd, so dark/total != 1/2
+		uint16_t total = (uint16_t)d.getPenaltyScore.qrsize * d.getPenaltyScore.qrsize;  // Note that size is odd, so dark/total != 1/2
 		// Compute the smallest integer k >= 0 such that (45-5k)% <= dark/total <= (55+5k)%
-		int k = (int)((labs(dark * 20L - total * 10L) + total - 1) / total) - 1;
-		result += k * PENALTY_N4;
-		return result;
+		int k = (int)((labs(d.getPenaltyScore.dark * 20L - total * 10L) + total - 1) / total) - 1;
+		d.getPenaltyScore.result += k * PENALTY_N4;
+		return d.getPenaltyScore.result;
 	}
 }
 
 
+// NES-QR-DEMO: starts a line (row or column) of modules with a light run of length 0
+// and an empty history. A helper function for getPenaltyScore().
+static void finderPenaltyBegin() {
+	d.getPenaltyScore.runColor = false;
+	d.getPenaltyScore.run = 0;
+	memset(d.getPenaltyScore.runHistory, 0, sizeof(d.getPenaltyScore.runHistory));
+}
+
+
 // Can only be called immediately after a light run is added, and
 // returns either 0, 1, or 2. A helper function for getPenaltyScore().
-static uint8_t finderPenaltyCountPatterns(const int runHistory[7]) {
-	int n = runHistory[1];
-	bool core = n > 0 && runHistory[2] == n && runHistory[3] == n * 3 && runHistory[4] == n && runHistory[5] == n;
-	// The maximum QR Code size is 177, hence the dark run length n <= 177.
-	// Arithmetic is promoted to int, so n*4 will not overflow.
-	return (core && runHistory[0] >= n * 4 && runHistory[6] >= n ? 1 : 0)
-	     + (core && runHistory[6] >= n * 4 && runHistory[0] >= n ? 1 : 0);
+static uint8_t finderPenaltyCountPatterns() {
+	uint8_t n = d.getPenaltyScore.runHistory[1];
+	bool core = n > 0 && d.getPenaltyScore.runHistory[2] == n && d.getPenaltyScore.runHistory[3] == n * 3 && d.getPenaltyScore.runHistory[4] == n && d.getPenaltyScore.runHistory[5] == n;
+	// NES-QR-DEMO: the 7n modules of the core fit in a line of at most 125, hence n <= 17
+	// whenever core holds, and n*4 is still below the 255 that run lengths saturate at.
+	return (core && d.getPenaltyScore.runHistory[0] >= n * 4 && d.getPenaltyScore.runHistory[6] >= n ? 1 : 0)
+	     + (core && d.getPenaltyScore.runHistory[6] >= n * 4 && d.getPenaltyScore.runHistory[0] >= n ? 1 : 0);
 }
 
 
 // Must be called at the end of a line (row or column) of modules. A helper function for getPenaltyScore().
-static int finderPenaltyTerminateAndCount(bool currentRunColor, int currentRunLength, int runHistory[7], int qrsize) {
-	if (currentRunColor) {  // Terminate dark run
-		finderPenaltyAddHistory(currentRunLength, runHistory, qrsize);
-		currentRunLength = 0;
+static uint8_t finderPenaltyTerminateAndCount() {
+	if (d.getPenaltyScore.runColor) {  // Terminate dark run
+		finderPenaltyAddHistory(d.getPenaltyScore.run);
+		d.getPenaltyScore.run = 0;
 	}
-	currentRunLength += qrsize;  // Add light border to final run
-	finderPenaltyAddHistory(currentRunLength, runHistory, qrsize);
-	return finderPenaltyCountPatterns(runHistory);
+	// Add light border to final run
+	finderPenaltyAddHistory(finderPenaltyAddBorder(d.getPenaltyScore.run));
+	return finderPenaltyCountPatterns();
 }
 
 
 // Pushes the given value to the front and drops the last value. A helper function for getPenaltyScore().
-static void finderPenaltyAddHistory(int currentRunLength, int runHistory[7], int qrsize) {
-	if (runHistory[0] == 0)
-		currentRunLength += qrsize;  // Add light border to initial run
-	memmove(&runHistory[1], &runHistory[0], 6 * sizeof(runHistory[0]));
-	runHistory[0] = currentRunLength;
+static void fastcall finderPenaltyAddHistory(uint8_t currentRunLength) {
+	if (d.getPenaltyScore.runHistory[0] == 0)
+		currentRunLength = finderPenaltyAddBorder(currentRunLength);  // Add light border to initial run
+	memmove(&d.getPenaltyScore.runHistory[1], &d.getPenaltyScore.runHistory[0], 6 * sizeof(d.getPenaltyScore.runHistory[0]));
+	d.getPenaltyScore.runHistory[0] = currentRunLength;
+}
+
+
+// NES-QR-DEMO: adds the light border of qrsize modules to a run, saturating at 255. Only
+// a line that is light from end to end goes past it, and finderPenaltyCountPatterns()
+// finds no pattern in that line either way.
+static uint8_t fastcall finderPenaltyAddBorder(uint8_t runLength) {
+	return runLength > 255 - d.getPenaltyScore.qrsize ? 255 : runLength + d.getPenaltyScore.qrsize;
 }
 
 
 
 /*---- Basic QR Code information ----*/
 
+// Public function - see documentation comment in header file.
+uint8_t qrcodegen_getMinVersion(size_t len) {
+	// NES-QR-DEMO: binary search of the capacity table generated by capgen.py
+	uint8_t lo = MIN_VERSION, hi = MAX_VERSION, mid;
+	if (len > qr_capacity[ecl][MAX_VERSION])
+		return 0;
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		if (len <= qr_capacity[ecl][mid])
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+
 // Public function - see documentation comment in header file.
 uint8_t qrcodegen_getSize() {
 	uint8_t result = qrcode[0];
@@ -771,24 +1001,17 @@ bool qrcodegen_getModule(int x, int y) {
 
 
 // Returns the color of the module at the given coordinates, which must be in bounds.
-testable bool getModuleBounded(const uint8_t buf[], int8_t x, int8_t y) {
-	d.getModuleBounded.index = y * BUFFER_WIDTH + x;
-	return getBit(buf[(d.getModuleBounded.index >> 3) + 1], d.getModuleBounded.index & 7);
+testable bool getModuleBounded(const uint8_t buf[], uint8_t x, uint8_t y) {
+	return (buf[(uint16_t)y * (BUFFER_WIDTH / 8) + (x >> 3) + 1] & MODULE_MASKS[x & 7]) != 0;
 }
 
 
 // Sets the color of the module at the given coordinates, which must be in bounds.
-testable void setModuleBounded(uint8_t buf[], int8_t x, int8_t y, bool isDark) {
-	static const uint8_t shifts[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
-	{
-		d.setModuleBounded.index = y * BUFFER_WIDTH + x;
-		d.setModuleBounded.bitIndex = d.setModuleBounded.index & 7;
-		d.setModuleBounded.byteIndex = (d.setModuleBounded.index >> 3) + 1;
-		if (isDark)
-			buf[d.setModuleBounded.byteIndex] |= shifts[d.setModuleBounded.bitIndex];
-		else
-			buf[d.setModuleBounded.byteIndex] &= shifts[d.setModuleBounded.bitIndex] ^ 0xFF;
-	}
+testable void setModuleBounded(uint8_t buf[], uint8_t x, uint8_t y, bool isDark) {
+	if (isDark)
+		buf[(uint16_t)y * (BUFFER_WIDTH / 8) + (x >> 3) + 1] |= MODULE_MASKS[x & 7];
+	else
+		buf[(uint16_t)y * (BUFFER_WIDTH / 8) + (x >> 3) + 1] &= MODULE_MASKS[x & 7] ^ 0xFF;
 }
 
 
@@ -796,37 +1019,43 @@ testable void setModuleBounded(uint8_t buf[], int8_t x, int8_t y, bool isDark) {
 testable void setModuleUnbounded(int8_t x, int8_t y, bool isDark) {
 	uint8_t qrsize = qrcode[0];
 	if (0 <= x && x < qrsize && 0 <= y && y < qrsize)
-		setModuleBounded(qrcode, x, y, isDark);
+		setModuleBounded(qrcode, (uint8_t)x, (uint8_t)y, isDark);
 }
 
 
 // Returns true iff the i'th bit of x is set to 1. Requires x >= 0 and 0 <= i <= 14.
-static bool fastcall getBit(int x, uint8_t i) {
+static bool fastcall getBit(uint16_t x, uint8_t i) {
 	return (x >> i) & 1;
 }
 
 
 
-/*---- Segment handling ----*/
+/*---- Phase timing ----*/
 
-// Calculates the number of bits needed to encode the given segments at the given version.
-// Returns a non-negative number if successful. Otherwise returns LENGTH_OVERFLOW if a segment
-// has too many characters to fit its length field, or the total bits exceeds INT16_MAX.
-testable uint16_t getTotalBits() {
-	uint8_t ccbits = numCharCountBits();
-	if (ccbits == 8 && dataLen >= 256)
-	{
-		return LENGTH_OVERFLOW;
-	}
-	return 4 + ccbits + bitLength;
+#ifdef QRCODEGEN_TIMING
+
+// NES-QR-DEMO: starts timing an encoding, with every phase at 0 frames
+static void phasesBegin() {
+	memset(qrcodegen_phaseFrames, 0, sizeof(qrcodegen_phaseFrames));
+	phaseStart = nesclock16();
+}
+
+
+// NES-QR-DEMO: adds the frames since the last phase ended to the given phase
+static void phaseEnd(enum qrcodegen_Phase phase) {
+	uint16_t now = nesclock16();
+	qrcodegen_phaseFrames[phase] += now - phaseStart;
+	phaseStart = now;
 }
 
+#endif
+
+
+
+/*---- Segment handling ----*/
 
 // Returns the bit width of the character count field for a segment in the given mode
 // in a QR Code at the given version number. The result is in the range [0, 16].
 static uint8_t numCharCountBits() {
 	return version < 10 ? 8 : 16;
 }
-
-
-#undef LENGTH_OVERFLOW
\ No newline at end of file
@@ -147,6 +147,10 @@ struct qrcodegen_Segment {
 // Use this more convenient value to avoid calculating tighter memory bounds for buffers.
 #define qrcodegen_BUFFER_LEN_MAX  qrcodegen_BUFFER_LEN_FOR_VERSION(qrcodegen_VERSION_MAX)
 
+// NES-QR-DEMO: the QR Code buffers store qrcodegen_BUFFER_WIDTH modules per row after the
+// size byte, leftmost module in the most significant bit. A byte is one row of a tile.
+#define qrcodegen_BUFFER_WIDTH  128
+
 
 
 /*---- Functions (high level) to generate QR Codes ----*/
@@ -156,6 +160,9 @@ struct qrcodegen_Segment {
  * If the data is too long to fit in any version in the given range
  * at the given ECC level, then false is returned.
  * 
+ * NES-QR-DEMO: the data is text[0 : dataLen], which is left untouched. The arrays
+ * below are tempBuffer and qrcode.
+ * 
  * Requires 1 <= minVersion <= maxVersion <= 40.
  * 
  * The smallest possible QR Code version within the given range is automatically
@@ -189,6 +196,52 @@ struct qrcodegen_Segment {
 bool qrcodegen_encodeBinary();
 
 
+#ifdef QRCODEGEN_REENCODE
+/* 
+ * NES-QR-DEMO: encodes the text of the last qrcodegen_encodeBinary() call again, with
+ * the current ecl, mask and boostEcl. The text and dataLen must not have changed since.
+ * The data bit string packed by the encodes before and the versions they looked up
+ * are used again, so mostly the padding onward is redone.
+ */
+bool qrcodegen_reencode();
+#endif
+
+
+/* 
+ * NES-QR-DEMO: switches the QR Code from the last successful encoding to the given
+ * mask (0 to 7), without encoding it again. This relies on tempBuffer still holding
+ * the function modules left there by the encoder, so it must not be written to in
+ * between. The mask global is updated to the new mask.
+ */
+void qrcodegen_setMask(enum qrcodegen_Mask msk);
+
+
+/* 
+ * NES-QR-DEMO: the steps of qrcodegen_encodeBinary(), in the order they run, except
+ * for the function modules which are drawn on both sides of the codewords. Mask
+ * tries only run when the mask is qrcodegen_Mask_AUTO, the last phase applies the
+ * chosen mask and draws its format bits.
+ */
+enum qrcodegen_Phase {
+	qrcodegen_Phase_VERSION,
+	qrcodegen_Phase_BITS,
+	qrcodegen_Phase_ECC,
+	qrcodegen_Phase_FUNCTION,
+	qrcodegen_Phase_CODEWORDS,
+	qrcodegen_Phase_MASK_0,  // and one more for each mask up to 7
+	qrcodegen_Phase_FORMAT = qrcodegen_Phase_MASK_0 + 8,
+	qrcodegen_Phase_COUNT,
+};
+
+#ifdef QRCODEGEN_TIMING
+/* 
+ * NES-QR-DEMO: the frames each phase of the last call of qrcodegen_encodeBinary()
+ * took, counted with nesclock16() of neslib.
+ */
+extern uint16_t qrcodegen_phaseFrames[qrcodegen_Phase_COUNT];
+#endif
+
+
 /*---- Functions (low level) to generate QR Codes ----*/
 
 /* 
@@ -269,6 +322,14 @@ size_t qrcodegen_calcSegmentBufferSize(enum qrcodegen_Mode mode, size_t numChars
 uint8_t qrcodegen_getSize();
 
 
+/* 
+ * NES-QR-DEMO: returns the smallest version that holds len bytes of text at the
+ * current ecl, or 0 if no supported version does. This is a lookup in the capacity
+ * table generated at build time, so it is cheap enough to call on every keystroke.
+ */
+uint8_t qrcodegen_getMinVersion(size_t len);
+
+
 /* 
  * Returns the color of the module (pixel) at the given coordinates, which is false
  * for light or true for dark. The top left corner has the coordinates (x=0, y=0).
@@ -1,6 +1,6 @@
-  .export _reedSolomonMultiply
-  .importzp ptr1
-  .import popa
+  .export _reedSolomonMultiply, _reedSolomonMultiplyAdd
+  .importzp ptr1, ptr2, ptr3, tmp1, tmp2, _bank_prg
+  .import popa, popax, _bank_set
 
   .feature org_per_seg
 
@@ -279,30 +279,28 @@
   .segment "CODE"
   .reloc
 
+; The products by y are the 256 bytes at $8000 + (y & $3f) * $100 of bank y >> 6, and
+; bank_set maps back the bank that was mapped before, which is that of the caller.
+
 ; uint8_t __fastcall__ reedSolomonMultiply(uint8_t x, uint8_t y)
 _reedSolomonMultiply:
   ; A is the y-position
   ; Upper 2 bits give the bank
   tax
+  lda _bank_prg
+  sta tmp1
+  txa
   rol
   rol
   rol
   and #%00000011
-  sta $e000
-  lsr
-  sta $e000
-  lsr
-  sta $e000
-  lsr
-  sta $e000
-  lsr
-  sta $e000
+  jsr _bank_set
 
   ; Store y-position as upper byte of index, truncating the 2 MSB
   ; Remember we need to index into the upper 16KB PRG, i.e. from address $8000
   txa
   and #%00111111
-  adc #$80
+  ora #$80
   sta ptr1+1
 
   ; Pop x-position from stack and store as lower byte of index
@@ -312,17 +310,56 @@ _reedSolomonMultiply:
   ; Retrieve value from table
   ldy #$00
   lda (ptr1),y
+  tax
 
-  ; Restore upper 16KB PRG to bank 4
+  lda tmp1
+  jsr _bank_set
+  txa
   ldx #0
-  stx $e000
-  nop
-  stx $e000
-  ldx #1
-  stx $e000
-  ldx #0 ; Conveniently register x is 0
-  stx $e000
-  nop
-  stx $e000
-
   rts
+
+; void __fastcall__ reedSolomonMultiplyAdd(uint8_t result[], const uint8_t x[], uint8_t len, uint8_t y)
+; XORs the product of each of x[0 : len] and y into result[0 : len], 1 <= len, looking
+; all of them up with the bank of y mapped once. Neither array may be in $8000-$BFFF.
+_reedSolomonMultiplyAdd:
+  ; A is the y-position, whose row of products ptr1 points to
+  tax
+  lda _bank_prg
+  pha
+  txa
+  rol
+  rol
+  rol
+  and #%00000011
+  jsr _bank_set
+  txa
+  and #%00111111
+  ora #$80
+  sta ptr1+1
+  lda #0
+  sta ptr1
+
+  jsr popa
+  sta tmp1 ; len
+  jsr popax
+  sta ptr2 ; x
+  stx ptr2+1
+  jsr popax
+  sta ptr3 ; result
+  stx ptr3+1
+
+  ldy #0
+@next:
+  sty tmp2
+  lda (ptr2),y
+  tay
+  lda (ptr1),y
+  ldy tmp2
+  eor (ptr3),y
+  sta (ptr3),y
+  iny
+  cpy tmp1
+  bne @next
+
+  pla
+  jmp _bank_set
@@ -0,0 +1,47 @@
+# Start of XRAM_IMPORT in mapper.cfg, and QR_CAPACITY_MAX_TEXT of capgen.py
+import_address = 0x6000
+max_text = 1465
+
+### DO NOT MODIFY BELOW ###
+
+import sys
+
+if len(sys.argv) < 3 or len(sys.argv) > 6:
+  print('Usage:', sys.argv[0], '[text input] [sav output] [ECL: L, M, Q or H] [mask: 0-7 or A] [bECL: T or F]')
+  sys.exit(1)
+
+WRAM_ADDRESS = 0x6000
+WRAM_SIZE = 0x2000
+MAGIC = b'QRTX'
+MASK_AUTO = 0xff
+
+with open(sys.argv[1], 'rb') as text_in:
+  text = text_in.read()
+if len(text) > max_text:
+  print('Text is', len(text), 'bytes long, at most', max_text, 'fit')
+  sys.exit(1)
+
+settings = (sys.argv[3:] + ['L', '0', 'F'][len(sys.argv) - 3:])
+if settings[0] not in 'LMQH' or len(settings[0]) != 1 \
+    or settings[1] not in '01234567A' or len(settings[1]) != 1 \
+    or settings[2] not in 'TF' or len(settings[2]) != 1:
+  print('Bad settings:', *settings)
+  sys.exit(1)
+ecl = 'LMQH'.index(settings[0])
+mask = MASK_AUTO if settings[1] == 'A' else int(settings[1])
+boost = 1 if settings[2] == 'T' else 0
+
+# Same hash as text_import.c
+checksum = len(text)
+for b in bytes([ecl, mask, boost]) + text:
+  checksum = (checksum * 31 + b) & 0xffff
+
+blob = MAGIC + len(text).to_bytes(2, 'little') + checksum.to_bytes(2, 'little') \
+  + bytes([ecl, mask, boost, 0]) + text
+
+# Whatever else is in WRAM fails its own checks and is ignored
+sav = bytearray(WRAM_SIZE)
+offset = import_address - WRAM_ADDRESS
+sav[offset:offset + len(blob)] = blob
+with open(sys.argv[2], 'wb') as sav_out:
+  sav_out.write(sav)
@@ -5,13 +5,17 @@
 #include <stdbool.h>
 
 extern uint8_t tempBuffer[];
+extern uint8_t text[];
 extern size_t dataLen;
 extern uint8_t qrcode[];
 extern enum qrcodegen_Ecc ecl;
 extern enum qrcodegen_Mask mask;
 extern bool boostEcl;
 
-void screen_editor (void);
+// Returns the key that left it, KEYBOARD_F8 to encode the text or KEYBOARD_F4 for the pack
+uint8_t screen_editor (void);
 void screen_qr (void);
+// Shows the codes encoded ahead of time by packgen.py
+void screen_pack (void);
 
 #endif // SCREEN_H_
@@ -1,56 +1,160 @@
 #include "keyboard.h"
 #include "build/chr.h"
+#include "build/capacity.h"
+#include "qr_cache.h"
+#include "qr_tiles.h"
 #include "screen.h"
+#include "text_import.h"
+#include "vramq.h"
 #include <string.h>
 
 #define CHR_CURSOR 0x7f
+#define CHR_UNDERLINE '_'
+#define CURSOR_SPR_ID 4 // same as the QR screen status, which replaces it
+#if defined(EDITOR_LATENCY)
+#define TEXT_TOP 4 // nametable row of the first text row on screen
+#else
+#define TEXT_TOP 3
+#endif
+#define TEXT_ROWS (30 - TEXT_TOP)
+#define TEXT_NAMETABLE NAMETABLE_B
+#define TEXT_RING_ROWS 30 // text rows held by TEXT_NAMETABLE, a couple more than fit on screen
+#define SCROLL_STEP 4 // lines per frame
+#define SPLIT_SPR_X 240
+#define SPLIT_SPR_Y ((TEXT_TOP << 3) - 9) // over the underline of the status bar, on its second to last line
+#define NO_ROW 0xff
 
 static const char palette[] = {
   0x0f, 0x0f, 0x0f, 0x30,
 };
-static const uint8_t status_bar_nametable[32 * 3] =
+static const uint8_t status_bar_nametable[32 * TEXT_TOP] =
   "F1 ECL ? F2 MASK ? F3 bECL ?    "
-  "F8 RUN CHAR ????/????           "
+  "F8 RUN CHAR ????/???? V?? +???? "
+#if defined(EDITOR_LATENCY)
+  "KEY LAG MIN -- AVG --.- MAX --  "
+#endif
   "________________________________";
 static const uint8_t ecl_values[4] = "LMQH";
 static const uint8_t bool_values[2] = "FT";
-static const uint8_t max_text_size[4][4] = {
-  "1465",
-  "1125",
-  "0805",
-  "0625",
-};
-static const uint8_t page_size[4] = "0864"; // 32 * (30 - 3)
+#if defined(EDITOR_LATENCY)
+static const uint8_t latency_template[18] = "-- AVG --.- MAX --";
+#endif
 
 #define ECL_VRAM NTADR_A(7, 0)
 #define MASK_VRAM NTADR_A(17, 0)
 #define BECL_VRAM NTADR_A(27, 0)
-#define TEXT_SIZE_VRAM NTADR_A(12, 1)
-#define MAX_TEXT_SIZE_VRAM NTADR_A(17, 1)
+#define CAPACITY_VRAM NTADR_A(12, 1)
+#define LATENCY_VRAM NTADR_A(12, 2)
+
+// Frames from the vblank that scanned a key which changed the text to the one that
+// uploaded its text row, over the last LATENCY_SAMPLES such keys. Every key is timed:
+// vramq has a single mark, so the keys whose rows are queued while it is taken are
+// marked together once it is past, up to the end of what is queued by then.
+#define LATENCY_SAMPLES 16 // power of 2, also the most keys waiting to be timed
+
+// The text is a gap buffer while it is edited: what comes before the cursor is at
+// [text, gap_start), what comes after it at [gap_end, TEXT_END). Every character
+// takes one cell, 32 to a text row.
+#define TEXT_END (text + QR_CAPACITY_MAX_TEXT)
+static uint8_t *gap_start, *gap_end;
+static uint16_t text_len, cursor; // kept in binary, converted to decimal for the status bar only
+
+// The status bar stays in the top rows of NAMETABLE_A, the text scrolls below it in
+// TEXT_NAMETABLE, which is switched to at a sprite 0 hit on the underline. Text row r
+// goes to nametable row r % TEXT_RING_ROWS, which only holds the rows from ring_top on.
+static uint8_t top; // text row to scroll to, the first one on screen once there
+static uint16_t scroll_y; // text line at the top of the screen
+static uint8_t ring_top;
 
-static uint8_t vram_buf[16];
-static uint16_t vram_ptr;
-static uint8_t *buf_ptr_start, *buf_ptr, *buf_ptr_tmp;
-static uint8_t text_size[4], *text_size_ptr;
+// Text rows still to be uploaded, a range from dirty_first to dirty_last (empty when
+// dirty_first > dirty_last), plus the row an edit started on which goes first.
+// Rows are uploaded one per frame, as are those about to scroll into view.
+static uint8_t dirty_first, dirty_last, edit_row;
+static bool capacity_dirty;
+
+static uint8_t row_buf[32];
+static uint8_t capacity_text[19]; // the "????/???? V?? +????" part of the status bar
+static uint8_t version;
+
+#if defined(EDITOR_LATENCY)
+static struct
+{
+  // Scan clocks of the keys not timed yet, a ring split by free-running indices into
+  // the keys under the mark [timed, marked), those whose row is queued [marked, queued)
+  // and those whose row is not [queued, typed)
+  uint8_t key_clocks[LATENCY_SAMPLES];
+  uint8_t timed, marked, queued, typed;
+  uint8_t samples[LATENCY_SAMPLES];
+  uint8_t next;
+  uint8_t count;
+  uint8_t min, max;
+  uint16_t sum;
+  bool dirty;
+  uint8_t text[sizeof(latency_template)]; // the "?? AVG ??.? MAX ??" part of the status bar
+} latency;
+#endif
 
-void fastcall _process_page (void);
+static struct
+{
+  uint8_t i;
+  uint8_t row;
+  uint16_t cell;
+  uint16_t y;
+  uint8_t *src;
+} d;
+
+void fastcall _open_gap (void);
+void fastcall _insert (uint8_t c);
+void fastcall _delete (void);
+void fastcall _move_left (uint16_t n);
+void fastcall _move_right (uint16_t n);
+void fastcall _mark_dirty (uint8_t first, uint8_t last);
+void fastcall _scroll_to_cursor (void);
+bool fastcall _scroll_step (void);
+void fastcall _upload (void);
+void fastcall _place_sprites (void);
+void fastcall _put_row (uint8_t row);
+void fastcall _update_capacity (void);
+void fastcall _put_decimal (uint8_t *dest, uint16_t n);
 uint8_t fastcall _mask_char (uint8_t delta);
+#if defined(EDITOR_LATENCY)
+void fastcall _latency_key (void);
+void fastcall _latency_queued (void);
+void fastcall _latency_update (void);
+#endif
 
 void main (void)
 {
   ecl = qrcodegen_Ecc_LOW;
   mask = qrcodegen_Mask_0;
   boostEcl = false;
+  qr_cache_restore();
+  text_import();
+  cursor = dataLen;
   keyboard_init();
 
-  screen_editor();
+  // The font keeps the lower half of pattern table 0 to itself, the QR screen never overwrites it
+  chr_rodata_ascii_vram_write();
+  qr_tiles_init();
+
+  while (1)
+  {
+    if (screen_editor() == KEYBOARD_F4)
+    {
+      screen_pack();
+    }
+    else
+    {
+      screen_qr();
+    }
+  }
 }
 
-void screen_editor (void)
+uint8_t screen_editor (void)
 {
   pal_bg(palette);
-  set_vram_update(vram_buf);
-  chr_data_ascii_vram_write();
+  // Sprites use the font pattern table, the cursor block shows behind the glyph it is on
+  pal_col(0x13, 0x00);
 
   vram_adr(NTADR_A(0, 0));
   vram_write(status_bar_nametable, sizeof(status_bar_nametable));
@@ -60,164 +164,338 @@ void screen_editor (void)
   vram_put(_mask_char(0));
   vram_adr(BECL_VRAM);
   vram_put(bool_values[boostEcl]);
-  vram_adr(MAX_TEXT_SIZE_VRAM);
-  vram_write(max_text_size[ecl], sizeof(max_text_size[0]));
-
-  buf_ptr_start = buf_ptr = tempBuffer;
-  memfill(text_size, '0', sizeof(text_size));
+  vram_adr(NAMETABLE_A + 0x3c0);
+  vram_fill(0, 64);
+  vram_adr(TEXT_NAMETABLE + 0x3c0);
+  vram_fill(0, 64);
 
-  _process_page();
-}
-
-void fastcall _process_page (void)
-{
-  ppu_off();
-  vram_buf[0] = NT_UPD_EOF;
+#if defined(EDITOR_LATENCY)
+  // Samples are kept across screens, the status bar shows them again
+  latency.timed = latency.marked = latency.queued = latency.typed = 0;
+  latency.dirty = latency.count != 0;
+#endif
 
-  vram_adr(TEXT_SIZE_VRAM);
-  vram_write(text_size, sizeof(text_size));
+  // The text is kept across screens, pick up where it was left
+  _open_gap();
+  dirty_first = edit_row = NO_ROW;
+  dirty_last = 0;
+  _scroll_to_cursor();
+  scroll_y = top << 3;
+  ring_top = top;
+  _mark_dirty(ring_top, ring_top + TEXT_RING_ROWS - 1);
+  capacity_dirty = true;
 
-  vram_ptr = NTADR_A(0, 3);
-  vram_adr(NTADR_A(0, 0) + sizeof(status_bar_nametable));
-  for (buf_ptr_tmp = buf_ptr_start; buf_ptr_tmp != buf_ptr; ++buf_ptr_tmp, ++vram_ptr)
+  // With rendering off the queue is flushed as it goes
+  while (capacity_dirty || dirty_first <= dirty_last)
   {
-    vram_put(*buf_ptr_tmp);
+    _upload();
   }
-  vram_put(0x7f);
-  vram_fill(0, NAMETABLE_B - vram_ptr - 1);
-
+  _place_sprites();
   ppu_on_all();
 
   while (1)
   {
-    keyboard_poll();
-    switch (keyboard_key_pressed)
+    // Everything typed since the last frame goes in before the screen catches up with it
+    for (keyboard_poll(); keyboard_key_pressed != KEYBOARD_NO_KEY; keyboard_poll())
     {
-    case KEYBOARD_NO_KEY:
-      break;
-
-    case KEYBOARD_F1:
-      ++ecl;
-      if (ecl == sizeof(ecl_values))
+      switch (keyboard_key_pressed)
       {
-        ecl = 0;
-      }
-      
-      vram_buf[0] = MSB(ECL_VRAM);
-      vram_buf[1] = LSB(ECL_VRAM);
-      vram_buf[2] = ecl_values[ecl];
-      vram_buf[3] = MSB(MAX_TEXT_SIZE_VRAM) | NT_UPD_HORZ;
-      vram_buf[4] = LSB(MAX_TEXT_SIZE_VRAM);
-      vram_buf[5] = sizeof(max_text_size[0]);
-      memcpy(&vram_buf[6], max_text_size[ecl], sizeof(max_text_size[0]));
-      vram_buf[6 + sizeof(max_text_size[0])] = NT_UPD_EOF;
-      break;
-
-    case KEYBOARD_F2:
-      vram_buf[0] = MSB(MASK_VRAM);
-      vram_buf[1] = LSB(MASK_VRAM);
-      vram_buf[2] = _mask_char(1);
-      vram_buf[3] = NT_UPD_EOF;
-      break;
-
-    case KEYBOARD_F3:
-      boostEcl ^= 1;
-      vram_buf[0] = MSB(BECL_VRAM);
-      vram_buf[1] = LSB(BECL_VRAM);
-      vram_buf[2] = bool_values[boostEcl];
-      vram_buf[3] = NT_UPD_EOF;
-      break;
-
-    case KEYBOARD_F8:
-      ppu_off();
-      set_vram_update(NULL);
-      dataLen = buf_ptr - tempBuffer;
-      screen_qr();
-      return;
+      case KEYBOARD_F1:
+        ++ecl;
+        if (ecl == sizeof(ecl_values))
+        {
+          ecl = 0;
+        }
+        vramq_fill(ECL_VRAM, ecl_values[ecl], 1);
+        capacity_dirty = true;
+        break;
 
-    case KEYBOARD_BACKSPACE:
-      if (buf_ptr == tempBuffer)
-      {
+      case KEYBOARD_F2:
+        vramq_fill(MASK_VRAM, _mask_char(1), 1);
         break;
-      }
 
-      for (text_size_ptr = &text_size[3]; ; --text_size_ptr)
-      {
-        if (*text_size_ptr != '0')
-        {
-          --*text_size_ptr;
-          break;
-        }
-        *text_size_ptr = '9';
-      }
+      case KEYBOARD_F3:
+        boostEcl ^= 1;
+        vramq_fill(BECL_VRAM, bool_values[boostEcl], 1);
+        break;
 
-      --buf_ptr;
-      if (buf_ptr == buf_ptr_start)
-      {
-        buf_ptr_start = tempBuffer;
-        _process_page();
-        return;
-      }
-      
-      --vram_ptr;
-      vram_buf[0] = MSB(vram_ptr) | NT_UPD_HORZ;
-      vram_buf[1] = LSB(vram_ptr);
-      vram_buf[2] = 2;
-      vram_buf[3] = CHR_CURSOR;
-      vram_buf[4] = ' ';
-      
-      vram_buf[5] = MSB(TEXT_SIZE_VRAM) | NT_UPD_HORZ;
-      vram_buf[6] = LSB(TEXT_SIZE_VRAM);
-      vram_buf[7] = 4;
-      memcpy(&vram_buf[8], text_size, sizeof(text_size));
-      vram_buf[8 + sizeof(text_size)] = NT_UPD_EOF;
-      
-      break;
-    
-    default:
-      if (strncmp((const char*)text_size, (const char*)max_text_size[ecl], sizeof(text_size)) >= 0)
-      {
+      case KEYBOARD_F4:
+      case KEYBOARD_F8:
+        // Keys still queued behind this one were typed for the editor, those typed from
+        // now on go to the next screen
+        keyboard_flush();
+        // The encoder wants the text in one piece
+        memmove(gap_start, gap_end, TEXT_END - gap_end);
+        dataLen = text_len;
+        // The screen is off while the text is encoded: with the split on, the NMI would
+        // spend the top of every frame waiting for sprite 0. The next screen turns it on.
+        vramq_wait();
+        scroll_split(0, 0xffff);
+        ppu_off();
+        oam_clear();
+        return keyboard_key_pressed;
+
+      case KEYBOARD_BACKSPACE:
+        _delete();
         break;
-      }
 
-      for (text_size_ptr = &text_size[3]; ; --text_size_ptr)
-      {
-        if (*text_size_ptr != '9')
-        {
-          ++*text_size_ptr;
-          break;
-        }
-        *text_size_ptr = '0';
-      }
+      case KEYBOARD_LEFT:
+        _move_left(1);
+        break;
 
-      *buf_ptr = keyboard_key_pressed;
-      ++buf_ptr;
+      case KEYBOARD_RIGHT:
+        _move_right(1);
+        break;
 
-      if (strncmp((const char*)text_size, (const char*)page_size, sizeof(text_size)) == 0)
-      {
-        buf_ptr_start = buf_ptr - 1;
-        _process_page();
-        return;
+      case KEYBOARD_UP:
+        _move_left(32);
+        break;
+
+      case KEYBOARD_DOWN:
+        _move_right(32);
+        break;
+
+      default:
+        _insert(keyboard_key_pressed);
       }
-      
-      vram_buf[0] = MSB(vram_ptr) | NT_UPD_HORZ;
-      vram_buf[1] = LSB(vram_ptr);
-      vram_buf[2] = 2;
-      vram_buf[3] = keyboard_key_pressed;
-      vram_buf[4] = CHR_CURSOR;
-      ++vram_ptr;
-
-      vram_buf[5] = MSB(TEXT_SIZE_VRAM) | NT_UPD_HORZ;
-      vram_buf[6] = LSB(TEXT_SIZE_VRAM);
-      vram_buf[7] = 4;
-      memcpy(&vram_buf[8], text_size, sizeof(text_size));
-      vram_buf[8 + sizeof(text_size)] = NT_UPD_EOF;
     }
 
+    _scroll_to_cursor();
+    _upload();
+    _place_sprites();
     ppu_wait_nmi();
+#if defined(EDITOR_LATENCY)
+    _latency_update();
+#endif
+  }
+}
+
+// Moves what follows the cursor of the last visit to the end of the text buffer. The
+// cursor is put back where it was, unless the text got shorter since.
+void fastcall _open_gap (void)
+{
+  text_len = dataLen;
+  if (cursor > text_len)
+  {
+    cursor = text_len;
+  }
+  gap_start = text + cursor;
+  gap_end = TEXT_END - (text_len - cursor);
+  memmove(gap_end, gap_start, text_len - cursor);
+}
+
+// The cells from the cursor to the end of the text all shift by one, the last one
+// clears when the text gets shorter
+void fastcall _insert (uint8_t c)
+{
+  if (text_len >= qr_capacity[ecl][QR_CAPACITY_MAX_VERSION])
+  {
+    return;
+  }
+  *gap_start++ = c;
+  _mark_dirty(cursor >> 5, text_len >> 5);
+#if defined(EDITOR_LATENCY)
+  _latency_key();
+#endif
+  ++text_len;
+  ++cursor;
+}
+
+void fastcall _delete (void)
+{
+  if (cursor == 0)
+  {
+    return;
+  }
+  --gap_start;
+  --cursor;
+  --text_len;
+  _mark_dirty(cursor >> 5, text_len >> 5);
+#if defined(EDITOR_LATENCY)
+  _latency_key();
+#endif
+}
+
+// Moving the cursor carries characters across the gap, the screen stays the same
+void fastcall _move_left (uint16_t n)
+{
+  for (; n != 0 && gap_start != text; --n)
+  {
+    *--gap_end = *--gap_start;
+    --cursor;
+  }
+}
+
+void fastcall _move_right (uint16_t n)
+{
+  for (; n != 0 && gap_end != TEXT_END; --n)
+  {
+    *gap_start++ = *gap_end++;
+    ++cursor;
+  }
+}
+
+// Adds text rows first to last, as far as they are in the nametable, to those to
+// upload. The first one is uploaded next, ahead of any row left from earlier edits.
+void fastcall _mark_dirty (uint8_t first, uint8_t last)
+{
+  capacity_dirty = true;
+  if (first < ring_top)
+  {
+    first = ring_top;
+  }
+  if (last > ring_top + TEXT_RING_ROWS - 1)
+  {
+    last = ring_top + TEXT_RING_ROWS - 1;
+  }
+  if (first > last)
+  {
+    return;
+  }
+
+  edit_row = first;
+  if (first < dirty_first)
+  {
+    dirty_first = first;
+  }
+  if (last > dirty_last)
+  {
+    dirty_last = last;
+  }
+}
+
+// Scrolls just enough for the row of the cursor to be on screen
+void fastcall _scroll_to_cursor (void)
+{
+  d.row = cursor >> 5;
+  if (d.row < top)
+  {
+    top = d.row;
+  }
+  else if (d.row >= top + TEXT_ROWS)
+  {
+    top = d.row - (TEXT_ROWS - 1);
   }
 }
 
+// Moves the view SCROLL_STEP lines closer to top. A row about to come into view is
+// uploaded first instead, in place of the one at the other end of the ring, which
+// is off screen by then. Tells whether a row was queued.
+bool fastcall _scroll_step (void)
+{
+  d.y = top << 3;
+  if (scroll_y < d.y)
+  {
+    if (d.y - scroll_y > SCROLL_STEP)
+    {
+      d.y = scroll_y + SCROLL_STEP;
+    }
+    if (((d.y + TEXT_ROWS * 8 - 1) >> 3) >= ring_top + TEXT_RING_ROWS)
+    {
+      ++ring_top;
+      _put_row(ring_top + TEXT_RING_ROWS - 1);
+      return true;
+    }
+  }
+  else if (scroll_y > d.y)
+  {
+    if (scroll_y - d.y > SCROLL_STEP)
+    {
+      d.y = scroll_y - SCROLL_STEP;
+    }
+    if ((d.y >> 3) < ring_top)
+    {
+      --ring_top;
+      _put_row(ring_top);
+      return true;
+    }
+  }
+  scroll_y = d.y;
+  return false;
+}
+
+// Queues at most one text row and the capacity, which fit the vblank budget together,
+// so that a whole edit shows one frame later whatever else is still pending. Scrolling
+// waits for a frame without an edit.
+void fastcall _upload (void)
+{
+  if (capacity_dirty)
+  {
+    capacity_dirty = false;
+    _update_capacity();
+    vramq_put(CAPACITY_VRAM, capacity_text, sizeof(capacity_text));
+  }
+
+  if (edit_row != NO_ROW)
+  {
+    _put_row(edit_row);
+#if defined(EDITOR_LATENCY)
+    _latency_queued();
+#endif
+    if (edit_row == dirty_first)
+    {
+      ++dirty_first;
+    }
+    edit_row = NO_ROW;
+  }
+#if defined(EDITOR_LATENCY)
+  else if (latency.dirty)
+  {
+    // In place of a text row, not to push the next edit past the vblank budget
+    latency.dirty = false;
+    vramq_put(LATENCY_VRAM, latency.text, sizeof(latency.text));
+  }
+#endif
+  else if (!_scroll_step() && dirty_first <= dirty_last)
+  {
+    _put_row(dirty_first++);
+  }
+
+  if (dirty_first > dirty_last)
+  {
+    dirty_first = NO_ROW;
+    dirty_last = 0;
+  }
+}
+
+void fastcall _put_row (uint8_t row)
+{
+  if (row < ring_top || row >= ring_top + TEXT_RING_ROWS)
+  {
+    return;
+  }
+
+  d.cell = (uint16_t)row << 5;
+  if (d.cell < cursor)
+  {
+    d.src = text + d.cell;
+  }
+  else
+  {
+    d.src = d.cell < text_len ? gap_end + (d.cell - cursor) : TEXT_END;
+  }
+  for (d.i = 0; d.i < sizeof(row_buf); ++d.i)
+  {
+    if (d.src == gap_start)
+    {
+      d.src = gap_end;
+    }
+    row_buf[d.i] = d.src == TEXT_END ? 0 : *d.src++;
+  }
+  vramq_put(TEXT_NAMETABLE + ((uint16_t)(row % TEXT_RING_ROWS) << 5), row_buf, sizeof(row_buf));
+}
+
+// The line after the hit shows the first line of the split, one line above the text
+// area. The cursor is hidden while its row is scrolled under the status bar.
+void fastcall _place_sprites (void)
+{
+  oam_spr(SPLIT_SPR_X, SPLIT_SPR_Y, CHR_UNDERLINE, OAM_BEHIND, 0);
+  scroll_split(256, (scroll_y + 239) % 240);
+
+  d.y = ((cursor >> 5) << 3) - scroll_y;
+  oam_spr((cursor & 31) << 3, d.y < TEXT_ROWS * 8 ? (TEXT_TOP << 3) + d.y - 1 : 0xff, CHR_CURSOR, OAM_BEHIND, CURSOR_SPR_ID);
+}
+
 uint8_t fastcall _mask_char (uint8_t delta)
 {
   mask += delta;
@@ -227,3 +505,120 @@ uint8_t fastcall _mask_char (uint8_t delta)
   }
   return (mask == qrcodegen_Mask_AUTO) ? 'A' : mask + '0';
 }
+
+// Fills capacity_text with the text size, the most text that fits at this ECL, and the
+// version the text needs along with how much more fits in it. Too long a text shows
+// no version and how much needs to go instead.
+void fastcall _update_capacity (void)
+{
+  _put_decimal(capacity_text, text_len);
+  capacity_text[4] = '/';
+  _put_decimal(&capacity_text[5], qr_capacity[ecl][QR_CAPACITY_MAX_VERSION]);
+  capacity_text[9] = ' ';
+  capacity_text[10] = 'V';
+  capacity_text[13] = ' ';
+
+  version = qrcodegen_getMinVersion(text_len);
+  if (version == 0)
+  {
+    capacity_text[11] = capacity_text[12] = '-';
+    capacity_text[14] = '-';
+    _put_decimal(&capacity_text[15], text_len - qr_capacity[ecl][QR_CAPACITY_MAX_VERSION]);
+  }
+  else
+  {
+    capacity_text[11] = '0' + version / 10;
+    capacity_text[12] = '0' + version % 10;
+    capacity_text[14] = '+';
+    _put_decimal(&capacity_text[15], qr_capacity[ecl][version] - text_len);
+  }
+}
+
+// Writes n, at most 9999, as 4 decimal digits
+void fastcall _put_decimal (uint8_t *dest, uint16_t n)
+{
+  for (d.src = dest + 3; d.src >= dest; --d.src, n /= 10)
+  {
+    *d.src = '0' + n % 10;
+  }
+}
+
+#if defined(EDITOR_LATENCY)
+
+// Only a run of more than LATENCY_SAMPLES keys ahead of the screen drops any
+void fastcall _latency_key (void)
+{
+  if ((uint8_t)(latency.typed - latency.timed) < LATENCY_SAMPLES)
+  {
+    latency.key_clocks[latency.typed & (LATENCY_SAMPLES - 1)] = keyboard_key_clock;
+    ++latency.typed;
+  }
+}
+
+// The rows of the keys typed so far are queued, marks them unless the mark is taken
+void fastcall _latency_queued (void)
+{
+  latency.queued = latency.typed;
+  if (latency.marked == latency.timed && latency.queued != latency.marked)
+  {
+    vramq_mark();
+    latency.marked = latency.queued;
+  }
+}
+
+// Adds the latency of the keys under the mark once it is past, marks those queued
+// since, and redoes the min, the average, in tenths, and the max of the samples
+void fastcall _latency_update (void)
+{
+  if (latency.marked == latency.timed || !vramq_mark_done())
+  {
+    return;
+  }
+  for (; latency.timed != latency.marked; ++latency.timed)
+  {
+    latency.samples[latency.next] = vramq_mark_clock() - latency.key_clocks[latency.timed & (LATENCY_SAMPLES - 1)];
+    latency.next = (latency.next + 1) & (LATENCY_SAMPLES - 1);
+    if (latency.count < LATENCY_SAMPLES)
+    {
+      ++latency.count;
+    }
+  }
+  if (latency.queued != latency.marked)
+  {
+    vramq_mark();
+    latency.marked = latency.queued;
+  }
+
+  latency.min = 0xff;
+  latency.max = 0;
+  latency.sum = 0;
+  for (d.i = 0; d.i < latency.count; ++d.i)
+  {
+    if (latency.samples[d.i] < latency.min)
+    {
+      latency.min = latency.samples[d.i];
+    }
+    if (latency.samples[d.i] > latency.max)
+    {
+      latency.max = latency.samples[d.i];
+    }
+    latency.sum += latency.samples[d.i];
+  }
+  latency.sum = latency.sum * 10 / latency.count;
+
+  // Shown up to 99 frames
+  memcpy(latency.text, latency_template, sizeof(latency.text));
+  if (latency.max < 100)
+  {
+    latency.text[0] = '0' + latency.min / 10;
+    latency.text[1] = '0' + latency.min % 10;
+    latency.text[7] = '0' + latency.sum / 100;
+    latency.text[8] = '0' + latency.sum / 10 % 10;
+    latency.text[10] = '0' + latency.sum % 10;
+    latency.text[16] = '0' + latency.max / 10;
+    latency.text[17] = '0' + latency.max % 10;
+  }
+  latency.dirty = true;
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include "neslib.h"
+#include "screen.h"
+#include "keyboard.h"
+#include "qr_tiles.h"
+#include "bank.h"
+#include "build/pack.h"
+#include <string.h>
+
+#define MENU_TOP 3 // nametable row of the first label
+#define LABEL_X 3
+#define CHOICE_SPR_X 8
+#define CHR_CHOICE '>'
+#define STATUS_SPR_X 8
+#define STATUS_SPR_Y 199
+#define STATUS_LINES 4
+#define STATUS_WIDTH 6
+#define SLIDE_FRAMES 240 // how long each code stays up in a slideshow
+
+static const char palette[] = {
+  0x0f, 0x0f, 0x0f, 0x30,
+};
+static const uint8_t title[] = "BUILT-IN CODES";
+static const uint8_t help[] = "RETURN SHOW SPACE SLIDES F4 EDIT";
+static const uint8_t status_template[STATUS_LINES][STATUS_WIDTH] = { "  /   ", "ECL   ", "MASK  ", "      " };
+static const uint8_t ecl_values[4] = "LMQH";
+
+static struct
+{
+  uint8_t selected;
+  bool slideshow;
+  uint8_t frames;
+  uint8_t i;
+  uint8_t j;
+  uint8_t spr_id;
+  const struct qr_pack_entry *entry;
+  const uint8_t *src;
+  uint8_t bank; // mapped before the one of the code shown
+  uint8_t status_text[STATUS_LINES][STATUS_WIDTH];
+} d;
+
+static void fastcall _show_menu (void);
+static void fastcall _view_codes (void);
+static void fastcall _show_code (void);
+static void fastcall _show_status (void);
+
+void screen_pack (void)
+{
+  _show_menu();
+  while (1)
+  {
+    keyboard_poll();
+    switch (keyboard_key_pressed)
+    {
+    case KEYBOARD_UP:
+      if (d.selected != 0)
+      {
+        --d.selected;
+      }
+      break;
+
+    case KEYBOARD_DOWN:
+      if (d.selected != QR_PACK_COUNT - 1)
+      {
+        ++d.selected;
+      }
+      break;
+
+    case KEYBOARD_RETURN:
+    case ' ':
+      d.slideshow = keyboard_key_pressed == ' ';
+      _view_codes();
+      _show_menu();
+      break;
+
+    case KEYBOARD_F4:
+      ppu_off();
+      oam_clear();
+      return;
+    }
+
+    oam_spr(CHOICE_SPR_X, ((MENU_TOP + d.selected) << 3) - 1, CHR_CHOICE, 0, 0);
+    ppu_wait_nmi();
+  }
+}
+
+// Lists the labels of the codes, with rendering off
+static void fastcall _show_menu (void)
+{
+  ppu_off();
+  oam_clear();
+  bank_bg(0);
+  bank_bg_split(0xff);
+  scroll_split(0, 0xffff);
+  pal_bg(palette);
+  pal_col(0x13, 0x30);
+
+  vram_adr(NAMETABLE_A);
+  vram_fill(0, 0x400);
+  vram_adr(NTADR_A(LABEL_X, 1));
+  vram_write(title, sizeof(title) - 1);
+  for (d.i = 0; d.i < QR_PACK_COUNT; ++d.i)
+  {
+    vram_adr(NTADR_A(LABEL_X, MENU_TOP + d.i));
+    vram_write(qr_pack[d.i].label, QR_PACK_LABEL_WIDTH);
+  }
+  vram_adr(NTADR_A(0, 28));
+  vram_write(help, sizeof(help) - 1);
+
+  oam_spr(CHOICE_SPR_X, ((MENU_TOP + d.selected) << 3) - 1, CHR_CHOICE, 0, 0);
+  ppu_on_all();
+}
+
+// Shows the selected code, going through them with the arrow keys or one after the
+// other in a slideshow, until a key other than those is pressed
+static void fastcall _view_codes (void)
+{
+  _show_code();
+  while (1)
+  {
+    keyboard_poll();
+    switch (keyboard_key_pressed)
+    {
+    case KEYBOARD_NO_KEY:
+      if (!d.slideshow || ++d.frames != SLIDE_FRAMES)
+      {
+        ppu_wait_nmi();
+        break;
+      }
+      // fall through to the next code
+
+    case KEYBOARD_RIGHT:
+      d.selected = d.selected == QR_PACK_COUNT - 1 ? 0 : d.selected + 1;
+      _show_code();
+      break;
+
+    case KEYBOARD_LEFT:
+      d.selected = d.selected == 0 ? QR_PACK_COUNT - 1 : d.selected - 1;
+      _show_code();
+      break;
+
+    case ' ':
+      d.slideshow ^= 1;
+      d.frames = 0;
+      _show_status();
+      break;
+
+    default:
+      return;
+    }
+  }
+}
+
+// Everything was worked out by packgen.py, all that is left is copying it to VRAM where
+// the QR screen would have put it, which takes a frame or two with rendering off. Only
+// the low plane of the tiles is written, the high plane of QR_TILES_PATTERN_TABLE is
+// kept clear by qr_tiles.
+static void fastcall _show_code (void)
+{
+  d.entry = &qr_pack[d.selected];
+  d.frames = 0;
+  ppu_off();
+  d.bank = bank_prg;
+  bank_set(d.entry->bank);
+
+  vram_adr(NAMETABLE_A);
+  vram_fill(0, 0x400);
+  d.src = d.entry->tiles;
+  for (d.i = 0; d.i < d.entry->tile_count; ++d.i, d.src += 8)
+  {
+    vram_adr(QR_TILES_PATTERN_TABLE + ((uint16_t)(d.i + 1) << 4));
+    vram_write(d.src, 8);
+  }
+  d.src = d.entry->map;
+  for (d.i = 0; d.i < d.entry->side; ++d.i, d.src += d.entry->side)
+  {
+    vram_adr(QR_TILES_NAMETABLE + ((uint16_t)d.i << 5));
+    vram_write(d.src, d.entry->side);
+  }
+
+  bank_set(d.bank);
+  pal_col(0, 0x30);
+  bank_bg(1);
+  _show_status();
+  ppu_on_all();
+}
+
+static void fastcall _show_status (void)
+{
+  memcpy(d.status_text, status_template, sizeof(status_template));
+  d.status_text[0][0] = '0' + (d.selected + 1) / 10;
+  d.status_text[0][1] = '0' + (d.selected + 1) % 10;
+  d.status_text[0][3] = '0' + QR_PACK_COUNT / 10;
+  d.status_text[0][4] = '0' + QR_PACK_COUNT % 10;
+  d.status_text[1][4] = ecl_values[d.entry->ecl];
+  d.status_text[2][5] = '0' + d.entry->mask;
+  if (d.slideshow)
+  {
+    memcpy(d.status_text[3], "SLIDES", STATUS_WIDTH);
+  }
+
+  // Sprites still use the font pattern table, whose glyphs are drawn in color 3
+  pal_col(0x13, 0x0f);
+  d.spr_id = 0;
+  for (d.i = 0; d.i < STATUS_LINES; ++d.i)
+  {
+    for (d.j = 0; d.j < STATUS_WIDTH; ++d.j)
+    {
+      if (d.status_text[d.i][d.j] != ' ')
+      {
+        d.spr_id = oam_spr(STATUS_SPR_X + (d.j << 3), STATUS_SPR_Y + (d.i << 3), d.status_text[d.i][d.j], 0, d.spr_id);
+      }
+    }
+  }
+  oam_hide_rest(d.spr_id);
+}
@@ -1,102 +1,252 @@
 #include "neslib.h"
+#include "bank.h"
 #include "screen.h"
 #include "keyboard.h"
+#include "qr_cache.h"
+#include "qr_tiles.h"
+#include "vramq.h"
+#include <string.h>
+
+#define STATUS_SPR_X 8
+#define STATUS_SPR_Y 199
+#define STATUS_LINES 3
+#define STATUS_WIDTH 7
+#define TIMING_X 8
+#define TIMING_Y 4
+#define TIMING_NAME_WIDTH 10
+#define TIMING_WIDTH (TIMING_NAME_WIDTH + 5)
+
+static const uint8_t status_template[STATUS_LINES][STATUS_WIDTH] = { "UPL    ", "ECL    ", "MASK   " };
+static const uint8_t ecl_values[4] = "LMQH";
+static const uint8_t phase_names[qrcodegen_Phase_COUNT][TIMING_NAME_WIDTH] = {
+  "VERSION   ", "BITS      ", "ECC       ", "FUNCTION  ", "CODEWORDS ",
+  "MASK 0    ", "MASK 1    ", "MASK 2    ", "MASK 3    ",
+  "MASK 4    ", "MASK 5    ", "MASK 6    ", "MASK 7    ", "FORMAT    ",
+};
+static const uint8_t timing_title[] = "ENCODING FRAMES";
+static const uint8_t timing_total[TIMING_NAME_WIDTH] = "TOTAL     ";
+static const uint8_t timing_settings[] = "V    ECL   MASK  ";
+static const uint8_t timing_back[] = "F3 CODE";
 
 struct
 {
-  uint8_t size;
+  uint8_t state;
   uint8_t coarse_y, coarse_x;
-  
-  union
-  {
-    uint8_t state;
-    struct
-    {
-      uint8_t tile_id, tile_count;
-    };
-    struct
-    {
-      uint8_t fine_y;
-      uint16_t qr_adr;
-      uint8_t pixel_row;
-    };
-  };
+  uint8_t upload_start;
+  uint8_t spr_id;
+  uint8_t status_text[STATUS_LINES][STATUS_WIDTH];
+  bool timing;
+  bool timed; // the phase timings are those of the code on screen
+  uint16_t total;
+  uint8_t line[sizeof(timing_settings) - 1];
 } data;
 
+void fastcall _show_result (void);
+void fastcall _upload (bool update);
+void fastcall _show_status (uint8_t frames);
+void fastcall _blank (void);
+void fastcall _clear (void);
+void fastcall _show_timing (void);
+void fastcall _hide_timing (void);
+void fastcall _put_frames (uint16_t frames);
 
 void screen_qr (void)
 {
-  vram_adr(0x0000);
-  vram_fill(0, NAMETABLE_B);
-
-  // Set upper 16KB PRG to bank 4
-  *(unsigned char*)0xe000 = 2 | 0;
-  *(unsigned char*)0xe000 = 4 | 0;
-  *(unsigned char*)0xe000 = 8 | 1;
-  *(unsigned char*)0xe000 = 16 | 0;
-  *(unsigned char*)0xe000 = 32 | 0;
-
-  data.state = qrcodegen_encodeBinary();
+  // The editor left rendering off, so the NMI has next to nothing to do while encoding
+  _blank();
+  // Nothing to encode if the text and settings are those of the code kept from last time
+  data.state = qr_cache_lookup();
+  data.timed = !data.state;
   if (!data.state)
   {
-    pal_col(0, 0x16);
+    qr_cache_invalidate();
+    data.state = bank_call(BANK_CODE, (unsigned int (*)(void))qrcodegen_encodeBinary);
   }
-  else
+  _show_result();
+
+  while (1)
   {
-    pal_col(0, 0x30);
-    vram_adr(0x0010);
-    vram_fill(0xff, 8);
-    data.size = qrcodegen_getSize();
-    // round to next multiple of 8
-    if (data.size != 0)
+    keyboard_poll();
+    if (data.timing && keyboard_key_pressed == KEYBOARD_F2)
     {
-      data.size = (data.size & ~7) + 8;
+      // The mask is changed on the code, which is put back first
+      _hide_timing();
     }
 
-    data.tile_id = 1;
-    data.tile_count = data.size / 8;
-    for (data.coarse_y = 1; data.coarse_y <= data.tile_count; ++data.coarse_y)
+    if (keyboard_key_pressed == KEYBOARD_F1)
     {
-      vram_adr(NTADR_A(1, data.coarse_y));
-      for (data.coarse_x = 1; data.coarse_x <= data.tile_count; ++data.coarse_x, ++data.tile_id)
-      {
-        vram_put(data.tile_id);
-      }
+      // The text is encoded again from the bit string packed for the previous code. That
+      // code goes first, with its split, or the NMI would wait for sprite 0 in every
+      // frame of the encode.
+      _blank();
+      ecl = (ecl + 1) & 3;
+      qr_cache_invalidate();
+      data.state = bank_call(BANK_CODE, (unsigned int (*)(void))qrcodegen_reencode);
+      data.timed = true;
+      _show_result();
     }
-    
-    vram_adr(0x0010);
-    for (data.coarse_y = 0; data.coarse_y < data.size; data.coarse_y += 8)
+    else if (keyboard_key_pressed == KEYBOARD_F2 && data.state)
     {
-      for (data.coarse_x = 0; data.coarse_x < data.size; data.coarse_x += 8)
+      // Masking only XORs the data modules, so the symbol is remasked in place. Its split
+      // stays on for the upload, which only replaces what the new mask changed.
+      qr_cache_invalidate();
+      qrcodegen_setMask((mask + 1) & 7);
+      qr_cache_store();
+      _upload(true);
+    }
+    else if (keyboard_key_pressed == KEYBOARD_F3 && data.state)
+    {
+      // A code kept from last time was not encoded here, the timings are of another one
+      if (data.timing)
+      {
+        _hide_timing();
+      }
+      else if (data.timed)
       {
-        // FIXME this will read out of bounds for the last row of tiles
-        for (data.fine_y = data.coarse_y; data.fine_y < data.coarse_y + 8; ++data.fine_y)
-        {
-          data.qr_adr = data.fine_y << 8;
-          data.qr_adr += data.coarse_x;
-          data.qr_adr >>= 3;
-          ++data.qr_adr;
-          data.pixel_row = qrcode[data.qr_adr];
-          data.pixel_row = (data.pixel_row & 0xF0) >> 4 | (data.pixel_row & 0x0F) << 4;
-          data.pixel_row = (data.pixel_row & 0xCC) >> 2 | (data.pixel_row & 0x33) << 2;
-          data.pixel_row = (data.pixel_row & 0xAA) >> 1 | (data.pixel_row & 0x55) << 1;
-          vram_put(data.pixel_row);
-        }
-        vram_fill(0x00, 8);
+        _show_timing();
       }
     }
+    else if (keyboard_key_pressed != KEYBOARD_NO_KEY)
+    {
+      break;
+    }
   }
-  
+
+  ppu_off();
+  oam_clear();
+  bank_bg(0);
+  bank_bg_split(0xff);
+}
+
+// Shows the symbol on a blank screen, turning rendering on if it is not yet
+void fastcall _show_result (void)
+{
+  data.timing = false;
   ppu_on_all();
-  while (1)
+
+  if (!data.state)
   {
-    keyboard_poll();
-    if (keyboard_key_pressed != KEYBOARD_NO_KEY)
+    pal_col(0, 0x16);
+  }
+  else
+  {
+    qr_cache_store();
+    pal_col(0, 0x30);
+    vramq_wait();
+    bank_bg(1);
+    _upload(false);
+  }
+}
+
+void fastcall _upload (bool update)
+{
+  // Each row is revealed once its tiles are queued ahead of it
+  data.upload_start = nesclock();
+  qr_tiles_begin(update);
+  for (data.coarse_y = 0; data.coarse_y < qr_tiles_side; ++data.coarse_y)
+  {
+    qr_tiles_row(data.coarse_y);
+  }
+
+  vramq_wait();
+  _show_status(nesclock() - data.upload_start);
+}
+
+void fastcall _show_status (uint8_t frames)
+{
+  memcpy(data.status_text, status_template, sizeof(status_template));
+  data.status_text[0][4] = '0' + frames / 100;
+  data.status_text[0][5] = '0' + frames / 10 % 10;
+  data.status_text[0][6] = '0' + frames % 10;
+  data.status_text[1][4] = ecl_values[ecl];
+  data.status_text[2][5] = '0' + mask;
+
+  // Sprites still use the font pattern table, whose glyphs are drawn in color 3
+  pal_col(0x13, 0x0f);
+  data.spr_id = 4; // sprite 0 is taken by the split
+  for (data.coarse_y = 0; data.coarse_y < STATUS_LINES; ++data.coarse_y)
+  {
+    for (data.coarse_x = 0; data.coarse_x < STATUS_WIDTH; ++data.coarse_x)
     {
-      break;
+      if (data.status_text[data.coarse_y][data.coarse_x] != ' ')
+      {
+        data.spr_id = oam_spr(STATUS_SPR_X + (data.coarse_x << 3), STATUS_SPR_Y + (data.coarse_y << 3),
+                              data.status_text[data.coarse_y][data.coarse_x], 0, data.spr_id);
+      }
     }
   }
-  
-  ppu_off();
-  screen_editor();
+}
+
+// Clears the screen and ends the splits, the size of the symbol may change next.
+// The splits go before sprite 0 does, or the NMI would wait for a hit that cannot come.
+void fastcall _blank (void)
+{
+  bank_bg_split(0xff);
+  scroll_split(0, 0xffff);
+  oam_clear();
+  _clear();
+}
+
+void fastcall _clear (void)
+{
+  for (data.coarse_y = 0; data.coarse_y < 30; ++data.coarse_y)
+  {
+    vramq_fill(NTADR_A(0, data.coarse_y), 0, 32);
+  }
+  vramq_fill(NAMETABLE_A + 0x3c0, 0, 64);
+}
+
+// The code makes room for the frames each phase of its encoding took, see qrcodegen.h.
+// They are written with the font, white on black, which the split would not show.
+void fastcall _show_timing (void)
+{
+  data.timing = true;
+  bank_bg_split(0xff);
+  oam_clear();
+  _clear();
+  vramq_wait();
+  bank_bg(0);
+  pal_col(0, 0x0f);
+
+  vramq_put(NTADR_A(TIMING_X, TIMING_Y), timing_title, sizeof(timing_title) - 1);
+  data.total = 0;
+  for (data.coarse_y = 0; data.coarse_y < qrcodegen_Phase_COUNT; ++data.coarse_y)
+  {
+    memcpy(data.line, phase_names[data.coarse_y], TIMING_NAME_WIDTH);
+    _put_frames(qrcodegen_phaseFrames[data.coarse_y]);
+    data.total += qrcodegen_phaseFrames[data.coarse_y];
+    vramq_put(NTADR_A(TIMING_X, TIMING_Y + 2) + (data.coarse_y << 5), data.line, TIMING_WIDTH);
+  }
+  memcpy(data.line, timing_total, TIMING_NAME_WIDTH);
+  _put_frames(data.total);
+  vramq_put(NTADR_A(TIMING_X, TIMING_Y + 3 + qrcodegen_Phase_COUNT), data.line, TIMING_WIDTH);
+
+  memcpy(data.line, timing_settings, sizeof(data.line));
+  data.coarse_x = (qrcodegen_getSize() - 17) >> 2;
+  data.line[2] = '0' + data.coarse_x / 10;
+  data.line[3] = '0' + data.coarse_x % 10;
+  data.line[9] = ecl_values[ecl];
+  data.line[16] = '0' + mask;
+  vramq_put(NTADR_A(TIMING_X, TIMING_Y + 5 + qrcodegen_Phase_COUNT), data.line, sizeof(data.line));
+  vramq_put(NTADR_A(TIMING_X, TIMING_Y + 7 + qrcodegen_Phase_COUNT), timing_back, sizeof(timing_back) - 1);
+}
+
+void fastcall _hide_timing (void)
+{
+  data.timing = false;
+  _clear();
+  vramq_wait();
+  pal_col(0, 0x30);
+  bank_bg(1);
+  _upload(false);
+}
+
+// Writes frames right-aligned in the last 5 characters of the line
+void fastcall _put_frames (uint16_t frames)
+{
+  for (data.coarse_x = TIMING_WIDTH - 1; data.coarse_x >= TIMING_NAME_WIDTH; --data.coarse_x)
+  {
+    data.line[data.coarse_x] = '0' + frames % 10;
+    frames /= 10;
+  }
 }
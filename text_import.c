@@ -0,0 +1,78 @@
+#include "text_import.h"
+#include "qr_cache.h"
+#include "screen.h"
+#include "build/capacity.h"
+#include <string.h>
+
+#define MASK_AUTO 0xff // how qrcodegen_Mask_AUTO is written
+
+static const uint8_t import_magic[4] = "QRTX";
+
+#pragma bss-name (push, "IMPORT")
+
+// As laid out by savgen.py, at the start of the XRAM_IMPORT area of mapper.cfg. That is
+// tempBuffer of the encoder too, so the blob is read at power on before anything encodes.
+static struct
+{
+  uint8_t magic[4]; // import_magic if the rest is valid
+  uint16_t len;
+  uint16_t checksum; // of everything below and len
+  uint8_t ecl;
+  uint8_t mask;
+  uint8_t boost;
+  uint8_t reserved;
+  uint8_t text[QR_CAPACITY_MAX_TEXT];
+} blob;
+
+#pragma bss-name (pop)
+
+static struct
+{
+  uint16_t checksum;
+  const uint8_t *src;
+  uint16_t i;
+} d;
+
+static uint16_t _checksum (void);
+
+bool text_import (void)
+{
+  if (memcmp(blob.magic, import_magic, sizeof(import_magic)) != 0)
+  {
+    return false;
+  }
+
+  // Only ever looked at once, so later edits are not overwritten at the next power on
+  blob.magic[0] = 0;
+  if (blob.len > QR_CAPACITY_MAX_TEXT
+      || blob.ecl > qrcodegen_Ecc_HIGH
+      || (blob.mask > qrcodegen_Mask_7 && blob.mask != MASK_AUTO)
+      || blob.boost > 1
+      || blob.checksum != _checksum())
+  {
+    return false;
+  }
+
+  memcpy(text, blob.text, blob.len);
+  dataLen = blob.len;
+  ecl = blob.ecl;
+  mask = blob.mask == MASK_AUTO ? qrcodegen_Mask_AUTO : blob.mask;
+  boostEcl = blob.boost;
+  qr_cache_invalidate();
+  return true;
+}
+
+// Same hash as the QR Code cache, over len, the settings and then the text
+static uint16_t _checksum (void)
+{
+  d.checksum = blob.len;
+  d.checksum = (d.checksum << 5) - d.checksum + blob.ecl;
+  d.checksum = (d.checksum << 5) - d.checksum + blob.mask;
+  d.checksum = (d.checksum << 5) - d.checksum + blob.boost;
+  d.src = blob.text;
+  for (d.i = blob.len; d.i != 0; --d.i)
+  {
+    d.checksum = (d.checksum << 5) - d.checksum + *d.src++;
+  }
+  return d.checksum;
+}
@@ -0,0 +1,13 @@
+#if !defined(TEXT_IMPORT_H_)
+#define TEXT_IMPORT_H_
+
+#include <stdbool.h>
+
+// A text prepared on a computer by savgen.py, found in battery-backed WRAM at power
+// on, so that it does not have to be typed in
+
+// Replaces the text, dataLen, ecl, mask and boostEcl with those of the imported text
+// if there is a valid one, which is then used up. Returns true in that case.
+bool text_import (void);
+
+#endif // TEXT_IMPORT_H_
@@ -0,0 +1,25 @@
+#if !defined(VRAMQ_H_)
+#define VRAMQ_H_
+
+// VRAM upload queue drained by the NMI handler, see vramq.s.
+// Unlike set_vram_update, entries stay queued until there is vblank time to
+// upload them, so arbitrarily large uploads can be done with rendering on.
+// With rendering off the queue is flushed right away by the main thread.
+
+// queue a copy of len (1..252) bytes from src to adr, waiting for room if needed
+void __fastcall__ vramq_put(unsigned int adr, const unsigned char *src, unsigned char len);
+// queue a fill of len (1..252) bytes of n at adr, waiting for room if needed
+void __fastcall__ vramq_fill(unsigned int adr, unsigned char n, unsigned char len);
+// wait until everything queued has been uploaded
+void __fastcall__ vramq_wait(void);
+// set the number of bytes uploaded per vblank, 0 uploads everything at once.
+// Runs queued after that are split into entries of at most that many bytes.
+void __fastcall__ vramq_budget(unsigned char bytes);
+// mark the end of what is queued so far, to know when it has all been uploaded
+void __fastcall__ vramq_mark(void);
+// nonzero once everything queued before the last mark has been uploaded
+unsigned char __fastcall__ vramq_mark_done(void);
+// nesclock() at the end of the vblank that uploaded it, once vramq_mark_done
+unsigned char __fastcall__ vramq_mark_clock(void);
+
+#endif // VRAMQ_H_
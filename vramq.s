@@ -0,0 +1,396 @@
+;VRAM upload queue, drained by the NMI handler within a per-frame byte budget
+;included from crt0.s right after neslib.s, shares its zero page variables
+;
+;the queue is a 256-byte ring, entries are added by the main thread and
+;removed by the NMI, so the head and tail indices each have a single writer
+;entry format:
+;  MSB, LSB, LEN, [LEN bytes]	copy a run of bytes to VRAM
+;  MSB|VRAMQ_FILL, LSB, LEN, n	fill a run of VRAM with n
+;LEN is 1..252, runs are always written with the +1 address increment.
+;vramq_put and vramq_fill split a run into entries no longer than the budget,
+;so that a single entry never takes more than one vblank
+;
+;a mark is a head index the main thread waits on, the NMI that moves the tail
+;past it writes down the frame count it ends with and clears VRAMQ_MARKED
+
+
+	.export _vramq_put,_vramq_fill,_vramq_wait,_vramq_budget
+	.export _vramq_mark,_vramq_mark_done,_vramq_mark_clock
+
+VRAMQ_FILL		=$80
+VRAMQ_BUDGET_DEFAULT	=64	;bytes per vblank, leaves room for OAM DMA and palette
+
+
+
+.segment "ZEROPAGE"
+
+VRAMQ_HEAD:		.res 1	;next free byte, written by the main thread only
+VRAMQ_TAIL:		.res 1	;next queued byte, written by the NMI only
+VRAMQ_BUDGET:		.res 1
+VRAMQ_LEFT:		.res 1
+VRAMQ_SRC:		.res 2
+VRAMQ_ADR:		.res 2
+VRAMQ_LEN:		.res 1	;bytes of the run left to queue
+VRAMQ_PART:		.res 1	;bytes of the entry being queued
+VRAMQ_MARK:		.res 1
+VRAMQ_MARKED:		.res 1	;set by the main thread, cleared by the NMI once past the mark
+VRAMQ_MARK_CLOCK:	.res 1
+
+
+
+.segment "BSS"
+
+VRAMQ_BUF:		.res 256
+
+
+
+.segment "CODE"
+
+;drain queued entries until the budget in VRAMQ_BUDGET runs out
+;the first entry of a call is always processed, even if it is over budget, which
+;only happens to entries queued before the budget was lowered. this is also how a
+;budget of 0 drains the whole queue at once
+;called by the NMI when rendering is enabled, or by vramq_reserve otherwise
+
+vramq_nmi:
+
+	ldx <VRAMQ_TAIL
+	cpx <VRAMQ_HEAD
+	beq @done
+
+	lda <PPU_CTRL_VAR
+	and #$fb
+	sta PPU_CTRL
+
+	lda <VRAMQ_BUDGET
+	sta <VRAMQ_LEFT
+
+@entry:
+
+	cpx <VRAMQ_HEAD
+	beq @end
+
+	txa
+	clc
+	adc #2
+	tay
+	lda <VRAMQ_LEFT
+	sec
+	sbc VRAMQ_BUF,y
+	bcs @fits
+	lda <VRAMQ_LEFT
+	cmp <VRAMQ_BUDGET
+	bne @end			;out of budget for this frame
+	lda #0
+
+@fits:
+
+	sta <VRAMQ_LEFT
+
+	lda VRAMQ_BUF,x
+	inx
+	cmp #VRAMQ_FILL		;carry is set for a fill
+	and #$3f
+	sta PPU_ADDR
+	lda VRAMQ_BUF,x
+	inx
+	sta PPU_ADDR
+	ldy VRAMQ_BUF,x
+	inx
+	bcs @fill
+
+@copy:
+
+	lda VRAMQ_BUF,x
+	inx
+	sta PPU_DATA
+	dey
+	bne @copy
+	beq @entry			;bra
+
+@fill:
+
+	lda VRAMQ_BUF,x
+	inx
+
+@1:
+
+	sta PPU_DATA
+	dey
+	bne @1
+	beq @entry			;bra
+
+@end:
+
+	stx <VRAMQ_TAIL
+
+	lda <VRAMQ_MARKED
+	beq @done
+	lda <VRAMQ_HEAD		;the mark is past once it is no longer between tail and head
+	sec
+	sbc <VRAMQ_TAIL
+	sta <VRAMQ_LEFT
+	lda <VRAMQ_MARK
+	sec
+	sbc <VRAMQ_TAIL
+	beq @marked
+	cmp <VRAMQ_LEFT
+	bcc @done
+	beq @done
+
+@marked:
+
+	ldx <FRAME_CNT1		;incremented later in the same NMI
+	inx
+	stx <VRAMQ_MARK_CLOCK
+	lda #0
+	sta <VRAMQ_MARKED
+
+@done:
+
+	rts
+
+
+
+;wait until the queue has room for A bytes, returns the head index in X
+;with rendering disabled the NMI does not drain the queue, so drain it here
+
+vramq_reserve:
+
+	sta <TEMP
+
+@1:
+
+	lda <VRAMQ_TAIL
+	clc
+	sbc <VRAMQ_HEAD		;free = tail - head - 1
+	cmp <TEMP
+	bcs @2
+	lda <PPU_MASK_VAR
+	and #%00011000
+	bne @1
+	jsr vramq_nmi
+	jmp @1
+
+@2:
+
+	ldx <VRAMQ_HEAD
+	rts
+
+
+
+;take the next entry off the VRAMQ_LEN bytes left of a run, at most VRAMQ_BUDGET of
+;them unless the budget is 0, returns its length in A and VRAMQ_PART
+
+vramq_part:
+
+	lda <VRAMQ_LEN
+	ldx <VRAMQ_BUDGET
+	beq @1
+	cpx <VRAMQ_LEN
+	bcs @1
+	txa
+
+@1:
+
+	sta <VRAMQ_PART
+	eor #$ff		;len - part = len + ~part + 1
+	sec
+	adc <VRAMQ_LEN
+	sta <VRAMQ_LEN
+	lda <VRAMQ_PART
+	rts
+
+
+
+;move VRAMQ_ADR past the entry just queued
+
+vramq_advance:
+
+	lda <VRAMQ_ADR
+	clc
+	adc <VRAMQ_PART
+	sta <VRAMQ_ADR
+	bcc @1
+	inc <VRAMQ_ADR+1
+
+@1:
+
+	rts
+
+
+
+;void __fastcall__ vramq_put(unsigned int adr,const unsigned char *src,unsigned char len);
+
+_vramq_put:
+
+	sta <VRAMQ_LEN
+	jsr popax
+	sta <VRAMQ_SRC
+	stx <VRAMQ_SRC+1
+	jsr popax
+	sta <VRAMQ_ADR
+	stx <VRAMQ_ADR+1
+
+@entry:
+
+	lda <VRAMQ_LEN
+	beq @2
+	jsr vramq_part
+	clc
+	adc #3
+	jsr vramq_reserve
+
+	lda <VRAMQ_ADR+1
+	sta VRAMQ_BUF,x
+	inx
+	lda <VRAMQ_ADR
+	sta VRAMQ_BUF,x
+	inx
+	lda <VRAMQ_PART
+	sta VRAMQ_BUF,x
+	inx
+
+	ldy #0
+
+@1:
+
+	lda (VRAMQ_SRC),y
+	sta VRAMQ_BUF,x
+	inx
+	iny
+	cpy <VRAMQ_PART
+	bne @1
+
+	stx <VRAMQ_HEAD		;publish the entry only once it is complete
+
+	tya
+	clc
+	adc <VRAMQ_SRC
+	sta <VRAMQ_SRC
+	bcc @3
+	inc <VRAMQ_SRC+1
+
+@3:
+
+	jsr vramq_advance
+	jmp @entry
+
+@2:
+
+	rts
+
+
+
+;void __fastcall__ vramq_fill(unsigned int adr,unsigned char n,unsigned char len);
+
+_vramq_fill:
+
+	sta <VRAMQ_LEN
+	jsr popa
+	sta <VRAMQ_SRC
+	jsr popax
+	sta <VRAMQ_ADR
+	stx <VRAMQ_ADR+1
+
+@entry:
+
+	lda <VRAMQ_LEN
+	beq @1
+	jsr vramq_part
+	lda #4
+	jsr vramq_reserve
+
+	lda <VRAMQ_ADR+1
+	ora #VRAMQ_FILL
+	sta VRAMQ_BUF,x
+	inx
+	lda <VRAMQ_ADR
+	sta VRAMQ_BUF,x
+	inx
+	lda <VRAMQ_PART
+	sta VRAMQ_BUF,x
+	inx
+	lda <VRAMQ_SRC
+	sta VRAMQ_BUF,x
+	inx
+
+	stx <VRAMQ_HEAD
+
+	jsr vramq_advance
+	jmp @entry
+
+@1:
+
+	rts
+
+
+
+;void __fastcall__ vramq_wait(void);
+
+_vramq_wait:
+
+	ldx <VRAMQ_TAIL
+	cpx <VRAMQ_HEAD
+	beq @1
+	lda <PPU_MASK_VAR
+	and #%00011000
+	bne _vramq_wait
+	jsr vramq_nmi
+	jmp _vramq_wait
+
+@1:
+
+	rts
+
+
+
+;void __fastcall__ vramq_budget(unsigned char bytes);
+
+_vramq_budget:
+
+	sta <VRAMQ_BUDGET
+	rts
+
+
+
+;void __fastcall__ vramq_mark(void);
+
+_vramq_mark:
+
+	lda <VRAMQ_HEAD
+	sta <VRAMQ_MARK
+	lda #1
+	sta <VRAMQ_MARKED
+	lda <VRAMQ_TAIL		;with nothing left to upload, no NMI would get to it
+	cmp <VRAMQ_MARK
+	bne @1
+	lda <FRAME_CNT1
+	sta <VRAMQ_MARK_CLOCK
+	lda #0
+	sta <VRAMQ_MARKED
+
+@1:
+
+	rts
+
+
+
+;unsigned char __fastcall__ vramq_mark_done(void);
+
+_vramq_mark_done:
+
+	ldx #0
+	lda <VRAMQ_MARKED
+	eor #1
+	rts
+
+
+
+;unsigned char __fastcall__ vramq_mark_clock(void);
+
+_vramq_mark_clock:
+
+	lda <VRAMQ_MARK_CLOCK
+	ldx #0
+	rts
@@ -0,0 +1,17 @@
+#if !defined(ZP_OVERLAY_H_)
+#define ZP_OVERLAY_H_
+
+// Zero page bytes shared by the encoder and the upload of its tiles, see zp_overlay.s.
+// Only one of them runs at a time and none keeps anything there for the other, so each
+// lays its scratch variables over the same bytes, under a name of its own:
+//   extern struct layout name;
+//   #pragma zpsym ("name")
+//   ZP_OVERLAY_CHECK(layout);
+// They then get zero page addressing, which is shorter and quicker, even for pointers.
+
+#define ZP_OVERLAY_SIZE 64 // as in zp_overlay.s
+
+// Does not compile if struct layout is larger than the overlay
+#define ZP_OVERLAY_CHECK(layout) typedef char layout##_fits_zp_overlay[sizeof(struct layout) <= ZP_OVERLAY_SIZE ? 1 : -1]
+
+#endif // ZP_OVERLAY_H_
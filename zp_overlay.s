@@ -0,0 +1,14 @@
+;zero page shared by the encoder and the upload of its tiles, see zp_overlay.h
+;each gives it a name of its own, and its own layout in C
+
+
+	.exportzp _qrcodegen_zp,_qr_tiles_zp
+
+ZP_OVERLAY_SIZE		=64	;as in zp_overlay.h
+
+
+
+.segment "ZEROPAGE"
+
+_qrcodegen_zp:
+_qr_tiles_zp:		.res ZP_OVERLAY_SIZE